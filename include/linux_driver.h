@@ -27,11 +27,38 @@
 
 #include <linux/types.h>
 #include <linux/ktime.h>
+#include <linux/cache.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/percpu-rwsem.h>
+#include <linux/list.h>
+#include <linux/wait.h>
+#include <linux/hrtimer.h>
+#include <linux/cdev.h>
+
+#include "linux_driver_api.h"
+#include "linux_driver_ring.h"
 
 #define DEVICE_NAME  "test_task_dev"
 #define DRIVER_NAME  "linux_driver"
 #define DEVICE_CLASS "test_task_dev_class"
 
+#define MAX_CHANNELS 256
+#define MAX_BATCH    1024 /* max number of messages per batch IOCTL */
+
+#define RING_MAX_SIZE (1 << 30) /* max ring buffer size, also at runtime resize */
+#define BUSY_POLL_MAX 1000      /* max busy-poll time before sleeping in microseconds */
+#define FLUSH_DELAY_MAX 1000000 /* max readers wake up delay in microseconds */
+
+#define RING_NODE_READER (-2) /* ring buffer is moved to the node of the first reader */
+
+/* broadcast modes (IOCTL_BROADCAST) */
+#define BCAST_OFF     0 /* readers share one tail, every byte is read once */
+#define BCAST_BLOCK   1 /* every reader gets all data, writer waits for the slowest one */
+#define BCAST_OVERRUN 2 /* every reader gets all data, writer overwrites unread data */
+
+#define LANES_MAX 4 /* max number of priority lanes per channel */
+
 /**
  * @brief Device buffer information structure.
  * 
@@ -48,12 +75,323 @@ typedef struct {
     uid_t  last_write_owner;
 } dev_buf_info_t;
 
-#define IOCTL_BLOCK    0
-#define IOCTL_NONBLOCK 1
-#define IOCTL_BUFINFO _IOR('k', 2, dev_buf_info_t)
+/**
+ * @brief Last operation information structure.
+ * 
+ * Read and write sides keep their own copy on separate
+ * cache lines, IOCTL_BUFINFO combines them into dev_buf_info_t.
+ */
+typedef struct {
+    ktime_t time;
+    pid_t   pid;
+    uid_t   owner;
+} dev_op_info_t;
+
+/**
+ * @brief Priority lane structure.
+ * 
+ * Lane 0 of a channel is its main ring buffer, higher lanes
+ * have their own ring buffers & writers lock. Higher lane
+ * number means higher priority.
+ */
+typedef struct {
+    ring_buffer_t ring;
+    struct mutex  write_lock; /* serializes writers of the lane */
+} dev_lane_t;
+
+/**
+ * @brief Argument of IOCTL_LANES.
+ * 
+ * Reads serve the highest non-empty lane first. Non-zero weight
+ * limits consecutive reads of a lane while a lower lane has data,
+ * so that bulk traffic is not starved.
+ */
+typedef struct {
+    u32 lanes;              /* number of lanes, 1 - disabled */
+    u32 weights[LANES_MAX]; /* per lane, 0 - strict priority */
+} dev_lanes_t;
+
+/**
+ * @brief Message descriptor structure.
+ * 
+ * Describes one message of IOCTL_SEND_BATCH/IOCTL_RECV_BATCH.
+ * For sending len is the message length, for receiving len is 
+ * the buffer size on input and the message length on output.
+ */
+typedef struct {
+    u64 buf; /* user space buffer address */
+    u32 len;
+    u32 pad;
+} dev_msg_t;
+
+/**
+ * @brief Messages batch structure.
+ * 
+ * Argument of IOCTL_SEND_BATCH/IOCTL_RECV_BATCH. IOCTL returns the 
+ * number of transferred messages (up to MAX_BATCH). Only the first
+ * message is waited for, the rest are transferred while available.
+ */
+typedef struct {
+    u64 msgs;  /* user space address of dev_msg_t array */
+    u32 count; /* number of dev_msg_t array entries */
+    u32 pad;
+} dev_msg_batch_t;
+
+/**
+ * @brief io_uring command payload structure.
+ * 
+ * Located in the SQE command area (sqe->cmd), fits into a regular 64 byte SQE.
+ * For URING_CMD_ENQUEUE/URING_CMD_DEQUEUE buf & len describe user space buffer,
+ * for URING_CMD_WAIT_READ/URING_CMD_WAIT_WRITE len is the number of bytes to wait for.
+ */
+typedef struct {
+    u64 buf;
+    u32 len;
+    u32 pad;
+} dev_uring_cmd_t;
+
+/**
+ * @brief io_uring command private data structure.
+ * 
+ * Stored in io_uring_cmd private area, since SQE can be reused 
+ * by user space while command is waiting for the ring buffer.
+ */
+typedef struct {
+    struct list_head node; /* entry of channel parked commands list */
+    u64              buf;
+    u32              len;
+} dev_uring_pdu_t;
+
+/**
+ * @brief Argument of IOCTL_LOWAT.
+ * 
+ * Readers are woken once read_lowat bytes (message headers included)
+ * or, in message mode, read_lowat_msgs messages are queued, by IOCTL_FLUSH,
+ * or flush_delay after the first held back write. Writers are woken once
+ * write_lowat bytes are free.
+ */
+typedef struct {
+    u32 read_lowat;
+    u32 write_lowat;
+    u32 flush_delay;     /* in microseconds, 0 - no deadline */
+    u32 read_lowat_msgs; /* 0 or 1 - any message */
+} dev_lowat_t;
+
+/**
+ * @brief Channel statistics structure.
+ * 
+ * Every CPU updates its own copy without atomics,
+ * copies are aggregated on read (see dev_stats_sum()).
+ */
+typedef struct {
+    u64 read_bytes;
+    u64 write_bytes;
+    u64 read_ops;
+    u64 write_ops;
+    u64 read_eagain;   /* non-blocking reads of empty ring buffer */
+    u64 write_eagain;  /* non-blocking writes to full ring buffer */
+    u64 read_sleeps;
+    u64 write_sleeps;
+    u64 read_wakeups;
+    u64 write_wakeups;
+    u64 empty_events;  /* reads that found ring buffer empty */
+    u64 full_events;   /* writes that found ring buffer full */
+    u64 poll_hits;     /* waits completed by busy-poll without sleeping */
+    u64 poll_misses;   /* busy-polls that ended up sleeping */
+    u64 lost_bytes;    /* data overwritten before readers got it */
+    u64 lost_msgs;     /* messages overwritten in overwrite mode */
+    u64 max_used;      /* ring buffer occupancy high-water mark */
+} dev_stats_t;
+
+/* latency histogram buckets: LAT_SUB_BUCKETS linear sub-buckets per power of two */
+#define LAT_SUB_BITS    2
+#define LAT_SUB_BUCKETS (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS     160 /* up to ~2^40 ns, larger values go to the last bucket */
+#define LAT_STAMPS      64  /* max number of writes in flight measured for residence */
+
+/* latency histogram types */
+#define LAT_READ_WAIT  0 /* reader sleep time waiting for data */
+#define LAT_WRITE_WAIT 1 /* writer sleep time waiting for free space */
+#define LAT_RESIDENCE  2 /* time from enqueue to complete dequeue of written data */
+#define LAT_TYPES      3
+
+/**
+ * @brief Channel latency histograms structure.
+ * 
+ * Per-CPU like dev_stats_t. Bucket of value v is v for v < LAT_SUB_BUCKETS,
+ * otherwise power of two range of v split into LAT_SUB_BUCKETS parts
+ * (relative error below 25%).
+ */
+typedef struct {
+    u64 counts[LAT_TYPES][LAT_BUCKETS];
+} dev_hist_t;
+
+/**
+ * @brief Argument of IOCTL_LAT_HIST.
+ * 
+ * User space sets type (LAT_*), driver fills counts in nanoseconds
+ * buckets (see dev_hist_t).
+ */
+typedef struct {
+    u32 type;
+    u32 pad;
+    u64 counts[LAT_BUCKETS];
+} dev_lat_hist_t;
+
+/** @brief Enqueue timestamp of a write for residence latency. */
+typedef struct {
+    u32 index; /* ring buffer head after the write */
+    u64 time;
+} dev_stamp_t;
+
+/**
+ * @brief Define read-only sysfs attribute of channel statistics counter.
+ * 
+ * @param [in] name - given dev_stats_t field name.
+ */
+#define DEV_STAT_ATTR(name)                                                                 \
+    static ssize_t name##_show(struct device *dev, struct device_attribute *attr, char *buf) \
+    {                                                                                       \
+        dev_stats_t stats;                                                                  \
+                                                                                            \
+        dev_stats_sum(dev_get_drvdata(dev), &stats);                                        \
+        return sysfs_emit(buf, "%llu\n", stats.name);                                       \
+    }                                                                                       \
+    static DEVICE_ATTR_RO(name)
+
+/**
+ * @brief Device channel structure.
+ * 
+ * Every minor number of the device is an independent channel
+ * with its own ring buffer, wait queues and last operations info.
+ * Opened files of the minor point to it (see dev_file_t),
+ * kernel modules get it with ldrv_channel_get().
+ */
+typedef struct ldrv_channel {
+    ring_buffer_t     ring;
+    struct mutex      read_lock;  /* serializes readers */
+    struct mutex      write_lock; /* serializes writers */
+    wait_queue_head_t read_queue;
+    wait_queue_head_t write_queue;
+    spinlock_t        uring_lock;    /* protects parked io_uring commands lists */
+    struct list_head  uring_readers; /* io_uring commands waiting for data */
+    struct list_head  uring_writers; /* io_uring commands waiting for free space */
+    struct list_head  uring_lockers; /* io_uring commands waiting for side lock or resize */
+    int               msg_mode;   /* length-prefixed messages instead of byte stream */
+    u32               busy_poll;     /* max spin time before sleeping in microseconds, 0 - disabled */
+    u32               read_poll_ns;  /* adaptive reader spin time */
+    u32               write_poll_ns; /* adaptive writer spin time */
+    u32               read_lowat;    /* queued bytes to wake readers, 0 or 1 - any data */
+    u32               read_lowat_msgs; /* queued messages to wake readers, 0 or 1 - any message */
+    atomic_t          held_msgs;     /* messages written since readers were woken (read_lowat_msgs only) */
+    u32               write_lowat;   /* free bytes to wake writers, 0 or 1 - any space */
+    u32               flush_delay;   /* max readers wake up delay in microseconds, 0 - none */
+    struct hrtimer    flush_timer;   /* wakes readers once flush_delay expires */
+    int               bcast;         /* BCAST_* mode */
+    spinlock_t        bcast_lock;    /* protects broadcast readers list */
+    struct list_head  bcast_readers; /* subscribed broadcast readers (dev_file_t) */
+    int               overwrite;     /* writers drop the oldest data instead of waiting */
+    atomic64_t        gap;           /* dropped bytes not reported to a reader yet */
+    u64               klost;         /* bytes kernel consumers lost to overwrites, under read_lock */
+    int               mp_mode;       /* writers reserve & commit slots without write_lock */
+    spinlock_t        reserve_lock;  /* serializes slot reservation */
+    u32               reserve ____cacheline_aligned_in_smp; /* end of reserved slots, head is end of committed ones */
+    u32               lanes;         /* number of priority lanes, lane 0 is ring */
+    u32               lane_weight[LANES_MAX]; /* max consecutive reads of a lane, 0 - unlimited */
+    u32               lane_served[LANES_MAX]; /* consecutive reads of a lane, under read_lock */
+    u64               lane_reads[LANES_MAX];  /* messages or chunks read per lane */
+    u64               lane_writes[LANES_MAX]; /* messages or chunks written per lane */
+    dev_lane_t        prio[LANES_MAX - 1];    /* lanes 1 and higher */
+    struct percpu_rw_semaphore resize_sem; /* held for read while ring buffer is accessed */
+    atomic_t          mmaps;      /* number of user space mappings, which prevent resize */
+    atomic_t          kusers;     /* number of kernel API users, which prevent resize */
+    int               node;       /* placement: node, NUMA_NO_NODE or RING_NODE_READER */
+    int               placed;     /* ring buffer was moved to the node of the first reader */
+    dev_stats_t __percpu *stats;
+    dev_hist_t __percpu  *hist;
+    dev_op_info_t     last_read  ____cacheline_aligned_in_smp;
+    dev_op_info_t     last_write ____cacheline_aligned_in_smp;
+    dev_stamp_t       stamps[LAT_STAMPS]; /* FIFO written under write_lock, read under read_lock */
+    u32               stamp_head ____cacheline_aligned_in_smp;
+    u32               stamp_tail ____cacheline_aligned_in_smp;
+    struct cdev       cdev;
+    struct device     *device;
+    u32               index;
+} dev_channel_t;
 
-#define DATE_FORMAT "%02d-%02d-%ld %02d:%02d:%02d"
-#define UTC_OFFSET  3 /* UTC+3 Moscow time */
+/**
+ * @brief Opened file structure.
+ * 
+ * Per file state, file private data points to it. Blocking mode
+ * is per file as well and is taken from O_NONBLOCK file flag.
+ * 
+ * In broadcast mode every subscribed reader has its own cursor
+ * instead of the shared tail. Ring buffer tail is the cursor of
+ * the slowest reader (BCAST_BLOCK) or is moved by the writer over
+ * unread data (BCAST_OVERRUN), overrun reader skips to the newest data.
+ */
+typedef struct {
+    dev_channel_t    *ch;
+    long             read_timeout;  /* in jiffies, MAX_SCHEDULE_TIMEOUT if not set */
+    long             write_timeout; /* in jiffies, MAX_SCHEDULE_TIMEOUT if not set */
+    struct mutex     lock;          /* serializes broadcast reads of this file */
+    struct list_head node;          /* entry of channel broadcast readers list */
+    u32              cursor;        /* broadcast read index */
+    bool             subscribed;
+    u64              lost;          /* bytes this reader lost to overruns or overwrites */
+    u32              lane;          /* priority lane of writes */
+} dev_file_t;
+
+/* set/clear O_NONBLOCK of the file, like fcntl() */
+#define IOCTL_BLOCK      0
+#define IOCTL_NONBLOCK   1
+#define IOCTL_BUFINFO    _IOR('k', 2, dev_buf_info_t)
+#define IOCTL_WAIT_READ  _IO('k', 3) /* arg - number of bytes to wait for */
+#define IOCTL_WAIT_WRITE _IO('k', 4) /* arg - number of free bytes to wait for */
+#define IOCTL_WAKE       _IO('k', 5)
+#define IOCTL_MSG_MODE   _IO('k', 6) /* arg - 0 for byte stream, 1 for messages */
+#define IOCTL_SEND_BATCH _IOW('k', 7, dev_msg_batch_t)
+#define IOCTL_RECV_BATCH _IOWR('k', 8, dev_msg_batch_t)
+
+/* io_uring command operations (sqe->cmd_op) */
+#define URING_CMD_ENQUEUE    _IOW('k', 9, dev_uring_cmd_t)
+#define URING_CMD_DEQUEUE    _IOW('k', 10, dev_uring_cmd_t)
+#define URING_CMD_WAIT_READ  _IOW('k', 11, dev_uring_cmd_t)
+#define URING_CMD_WAIT_WRITE _IOW('k', 12, dev_uring_cmd_t)
+
+#define IOCTL_LAT_HIST  _IOWR('k', 13, dev_lat_hist_t)
+#define IOCTL_LAT_RESET _IO('k', 14)
+#define IOCTL_RESIZE    _IO('k', 15) /* arg - new ring buffer size, requires CAP_SYS_ADMIN */
+
+/* arg - timeout in milliseconds for this file, 0 - no timeout */
+#define IOCTL_READ_TIMEOUT  _IO('k', 16)
+#define IOCTL_WRITE_TIMEOUT _IO('k', 17)
+#define IOCTL_BUSY_POLL     _IO('k', 18) /* arg - max spin time in microseconds, 0 - disabled */
+#define IOCTL_LOWAT         _IOW('k', 19, dev_lowat_t)
+#define IOCTL_FLUSH         _IO('k', 20)
+#define IOCTL_BROADCAST     _IO('k', 21) /* arg - BCAST_* mode */
+#define IOCTL_SUBSCRIBE     _IO('k', 22) /* subscribe before the first read */
+#define IOCTL_LOST          _IOR('k', 23, u64)
+#define IOCTL_OVERWRITE     _IO('k', 24) /* arg - 1 to overwrite the oldest data, 0 to block */
+#define IOCTL_MP_MODE       _IO('k', 25) /* arg - 1 for concurrent multi-producer writes */
+#define IOCTL_LANES         _IOW('k', 26, dev_lanes_t) /* requires CAP_SYS_ADMIN */
+#define IOCTL_LANE          _IO('k', 27) /* arg - priority lane of writes of this file */
+#define IOCTL_NUMA_NODE     _IO('k', 28) /* arg - node, -1 (local) or RING_NODE_READER, requires CAP_SYS_ADMIN */
+
+/**
+ * @brief Enqueue messages of a kernel producer.
+ * 
+ * With LDRV_ATOMIC slots are reserved without sleeping & without
+ * resize_sem, ring buffer is kept by ldrv_channel_get().
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] vec - given messages (byte chunks in byte stream mode).
+ * @param [in] count - given number of messages.
+ * @param [in] flags - given LDRV_* flags.
+ * @param [out] done - given pointer to store number of enqueued messages.
+ * @return result of the last enqueue (number of bytes or negative error).
+ */
+static ssize_t dev_kernel_write(dev_channel_t *ch, const struct kvec *vec, u32 count, u32 flags, u32 *done);
 
 /**
  * @brief Driver entry point. 
@@ -66,13 +404,615 @@ static s32 __init linux_driver_init(void);
 /** @brief Driver exit handler. */
 static void __exit linux_driver_exit(void);
 
+/**
+ * @brief Initialize device channel and its ring buffer.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] index - given channel index (minor number offset).
+ * @return 0 - in case of success. 
+ * @return negative number in case of error. 
+ */
+static s32 dev_channel_init(dev_channel_t *ch, u32 index);
+
+/**
+ * @brief Free device channel ring buffer.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_channel_free(dev_channel_t *ch);
+
+/**
+ * @brief Drop the oldest data until need bytes are free (overwrite mode).
+ * 
+ * Caller holds write side lock. Dropped bytes and messages (see ring_drop())
+ * are accounted and left as a gap for the next reader.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] need - given number of bytes to free.
+ * @param [in] msg_mode - given flag to drop whole messages.
+ */
+static void dev_ring_drop(dev_channel_t *ch, u32 need, bool msg_mode);
+
+/**
+ * @brief Get used ring buffer space without holding resize_sem.
+ * 
+ * @param [in] ch - given device channel.
+ * @return number of bytes available for reading.
+ */
+static u32 dev_ring_used(dev_channel_t *ch);
+
+/**
+ * @brief Get free ring buffer space without holding resize_sem.
+ * 
+ * @param [in] ch - given device channel.
+ * @return number of bytes available for writing.
+ */
+static u32 dev_ring_free(dev_channel_t *ch);
+
+/**
+ * @brief Get ring buffer of priority lane.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] lane - given lane (0 - channel ring buffer).
+ * @return lane ring buffer.
+ */
+static inline ring_buffer_t *dev_lane_ring(dev_channel_t *ch, u32 lane);
+
+/**
+ * @brief Get writers lock of priority lane.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] lane - given lane (0 - channel write_lock).
+ * @return lane write side lock.
+ */
+static inline struct mutex *dev_lane_lock(dev_channel_t *ch, u32 lane);
+
+/**
+ * @brief Get lane of writes of opened file.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] df - given opened file or NULL for kernel writers (lane 0).
+ * @return lane limited by the current number of lanes.
+ */
+static inline u32 dev_file_lane(dev_channel_t *ch, dev_file_t *df);
+
+/**
+ * @brief Get used space of priority lanes.
+ * 
+ * Caller holds resize_sem or RCU read lock.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] first - given lowest lane to count (0 - all lanes).
+ * @return number of bytes available for reading in lanes from first.
+ */
+static u32 dev_lanes_used(dev_channel_t *ch, u32 first);
+
+/**
+ * @brief Get free space of priority lane without holding resize_sem.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] lane - given lane.
+ * @return number of bytes available for writing (0 if lane was removed).
+ */
+static u32 dev_lane_free(dev_channel_t *ch, u32 lane);
+
+/**
+ * @brief Choose lane of the next read.
+ * 
+ * The highest non-empty lane is chosen, unless it was read lane_weight
+ * times in a row while a lower lane has data. Caller holds read side lock
+ * and resize_sem, at least one lane is not empty.
+ * 
+ * @param [in] ch - given device channel.
+ * @return lane to read from.
+ */
+static u32 dev_lane_pick(dev_channel_t *ch);
+
+/**
+ * @brief Replace channel ring buffer with a buffer of another size or placement.
+ * 
+ * Queued data is preserved. Size is rounded up to a power of two.
+ * Does nothing if size & node are unchanged.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] size - given new ring buffer size.
+ * @param [in] node - given NUMA node of data pages (NUMA_NO_NODE - local).
+ * @return 0 - in case of success. 
+ * @return -EINVAL - in case of incorrect size.
+ * @return -ENOMEM - in case of out of memory.
+ * @return -EBUSY - if ring buffer is mapped or queued data does not fit.
+ */
+static s32 dev_ring_resize(dev_channel_t *ch, unsigned long size, int node);
+
+/**
+ * @brief Set NUMA placement of channel ring buffer.
+ * 
+ * Ring buffer is moved at once to the given node, or
+ * at the next open for reading with RING_NODE_READER.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] node - given node, NUMA_NO_NODE (local to the caller) or RING_NODE_READER.
+ * @return 0 - in case of success. 
+ * @return -EINVAL - in case of offline or incorrect node.
+ * @return negative number in case of other error (see dev_ring_resize()).
+ */
+static s32 dev_ring_place(dev_channel_t *ch, long node);
+
+/**
+ * @brief Serialize readers or writers among themselves.
+ * 
+ * Side lock does nothing in SPSC mode, where the caller guarantees a single
+ * reader and a single writer. In non-blocking mode lock is only tried.
+ * Also prevents ring buffer resize until dev_unlock_side().
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] lock - given read or write side lock.
+ * @param [in] nowait - given non-blocking mode flag.
+ * @return 0 - in case of success. 
+ * @return -EAGAIN - if lock or resize_sem is contended in non-blocking mode
+ * (unlike -EAGAIN of data transfer, it says nothing about the ring buffer state).
+ * @return negative number in case of other error. 
+ */
+static s32 dev_lock_side(dev_channel_t *ch, struct mutex *lock, bool nowait);
+
+/**
+ * @brief Release read or write side lock.
+ * 
+ * io_uring commands which lost the race for the lock are retried.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] lock - given read or write side lock.
+ */
+static void dev_unlock_side(dev_channel_t *ch, struct mutex *lock);
+
+/**
+ * @brief Release resize_sem taken for write.
+ * 
+ * io_uring commands which found it taken are retried.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_resize_unlock(dev_channel_t *ch);
+
+/**
+ * @brief Take write side lock of the lane of opened file.
+ * 
+ * No lock is taken in multi-producer mode. Lane is rechecked
+ * under resize_sem, as lanes may be changed before it was taken.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] df - given opened file.
+ * @param [in] nowait - given non-blocking mode flag.
+ * @param [out] lock - given pointer to store the lock taken (for dev_unlock_side()).
+ * @param [out] lane - given pointer to store the lane of writes.
+ * @return 0 - in case of success. 
+ * @return -EAGAIN - if lock is contended in non-blocking mode (see dev_lock_side()).
+ * @return negative number in case of other error. 
+ */
+static s32 dev_lock_writer(dev_channel_t *ch, dev_file_t *df, bool nowait, struct mutex **lock, u32 *lane);
+
+/**
+ * @brief Check wait condition of a reader or writer.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] df - given broadcast reader or NULL.
+ * @param [in] lane - given lane of writer.
+ * @param [in] write - given flag to check free space instead of data.
+ * @param [in] count - given number of bytes (limited by ring buffer size).
+ * @return true - if enough data or free space is available.
+ */
+static inline bool dev_wait_ready(dev_channel_t *ch, dev_file_t *df, u32 lane, bool write, u32 count);
+
+/**
+ * @brief Spin for wait condition before sleeping.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] df - given broadcast reader or NULL.
+ * @param [in] lane - given lane of writer.
+ * @param [in] budget - given adaptive spin time in nanoseconds.
+ * @param [in] write - given flag to wait for free space instead of data.
+ * @param [in] count - given number of bytes.
+ * @return true - if condition became true while spinning.
+ */
+static bool dev_busy_poll(dev_channel_t *ch, dev_file_t *df, u32 lane, u32 *budget, bool write, u32 count);
+
+/**
+ * @brief Adapt spin time to the duration of the last sleep.
+ * 
+ * Spin time grows to twice of short sleeps (up to busy_poll)
+ * and halves after sleeps longer than busy_poll.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in,out] budget - given adaptive spin time in nanoseconds.
+ * @param [in] slept - given sleep duration in nanoseconds.
+ */
+static void dev_busy_poll_adapt(dev_channel_t *ch, u32 *budget, u64 slept);
+
+/**
+ * @brief Set channel busy-poll time.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] usecs - given max spin time in microseconds (0 - disabled).
+ * @return 0 - in case of success. 
+ * @return -EINVAL - if usecs exceeds BUSY_POLL_MAX. 
+ */
+static s32 dev_busy_poll_set(dev_channel_t *ch, unsigned long usecs);
+
+/**
+ * @brief Wait until ring buffer contains at least count bytes.
+ * 
+ * Must be called without resize_sem held, count is limited by ring buffer size.
+ * Spins first if busy-poll is enabled.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] df - given broadcast reader or NULL.
+ * @param [in] count - given number of bytes.
+ * @param [in,out] timeout - given max wait time in jiffies, set to remaining time.
+ * @return 0 - in case of success. 
+ * @return -ETIMEDOUT - in case of expired timeout. 
+ * @return -ERESTARTSYS - in case of signal. 
+ */
+static s32 dev_wait_readable(dev_channel_t *ch, dev_file_t *df, u32 count, long *timeout);
+
+/**
+ * @brief Wait until ring buffer has at least count free bytes.
+ * 
+ * Must be called without resize_sem held, count is limited by ring buffer size.
+ * Spins first if busy-poll is enabled.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] lane - given lane to wait for.
+ * @param [in] count - given number of bytes.
+ * @param [in,out] timeout - given max wait time in jiffies, set to remaining time.
+ * @return 0 - in case of success. 
+ * @return -ETIMEDOUT - in case of expired timeout. 
+ * @return -ERESTARTSYS - in case of signal. 
+ */
+static s32 dev_wait_writable(dev_channel_t *ch, u32 lane, u32 count, long *timeout);
+
+/**
+ * @brief Wake up wait queue only if somebody sleeps on it.
+ * 
+ * Poll mask is passed to the wake up functions of epoll,
+ * so only the waiters interested in these events are woken up.
+ * 
+ * @param [in] queue - given wait queue.
+ * @param [in] mask - given poll events that became ready.
+ * @return true - if there were sleepers to wake up.
+ */
+static inline bool dev_wake_up(struct wait_queue_head *queue, __poll_t mask);
+
+/**
+ * @brief Wake up readers waiting in any way for data.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_wake_readers(dev_channel_t *ch);
+
+/**
+ * @brief Wake up writers waiting in any way for free space.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_wake_writers(dev_channel_t *ch);
+
+/**
+ * @brief Wake up readers after write, honoring read_lowat & read_lowat_msgs.
+ * 
+ * Arms flush timer if readers are not woken yet.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_notify_readers(dev_channel_t *ch);
+
+/**
+ * @brief Wake up writers after read, honoring write_lowat.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_notify_writers(dev_channel_t *ch);
+
+/**
+ * @brief Wake up readers of data held back by read_lowat.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_flush(dev_channel_t *ch);
+
+/**
+ * @brief Wake up readers once flush delay expired.
+ * 
+ * @param [in] timer - given channel flush timer.
+ * @return HRTIMER_NORESTART.
+ */
+static enum hrtimer_restart dev_flush_timer(struct hrtimer *timer);
+
+/**
+ * @brief Set channel wake up watermarks (IOCTL_LOWAT).
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] arg - given user space watermarks structure.
+ * @return 0 - in case of success.
+ * @return -EINVAL - in case of incorrect watermarks.
+ * @return -EFAULT - in case of bad user pointer.
+ */
+static long dev_lowat_set(dev_channel_t *ch, dev_lowat_t __user *arg);
+
+/**
+ * @brief Get ring buffer head for a broadcast reader.
+ * 
+ * @param [in] ch - given device channel.
+ * @return head index.
+ */
+static u32 dev_bcast_head(dev_channel_t *ch);
+
+/**
+ * @brief Get number of bytes not read by broadcast reader yet.
+ * 
+ * @param [in] df - given broadcast reader.
+ * @return number of bytes, at most ring buffer size.
+ */
+static u32 dev_bcast_used(dev_file_t *df);
+
+/**
+ * @brief Move ring buffer tail to the cursor of the slowest broadcast reader.
+ * 
+ * Tail is moved to head if there are no readers. Caller holds resize_sem.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_bcast_update_tail(dev_channel_t *ch);
+
+/**
+ * @brief Subscribe file to broadcast data written from now on.
+ * 
+ * @param [in] df - given opened file.
+ */
+static void dev_bcast_subscribe(dev_file_t *df);
+
+/**
+ * @brief Remove file from broadcast readers.
+ * 
+ * @param [in] df - given opened file.
+ */
+static void dev_bcast_unsubscribe(dev_file_t *df);
+
+/**
+ * @brief Get broadcast reader of the file, subscribing it if needed.
+ * 
+ * @param [in] df - given opened file.
+ * @return df - in broadcast mode.
+ * @return NULL - if channel is not in broadcast mode.
+ */
+static dev_file_t *dev_bcast_reader(dev_file_t *df);
+
+/**
+ * @brief Check whether writer overwrote data not read by broadcast reader.
+ * 
+ * Overrun reader skips to the newest data, lost bytes are accounted.
+ * 
+ * @param [in] df - given broadcast reader.
+ * @return true - if reader was overrun.
+ */
+static bool dev_bcast_overrun(dev_file_t *df);
+
+/**
+ * @brief Advance broadcast reader cursor.
+ * 
+ * @param [in] df - given broadcast reader.
+ * @param [in] length - given number of bytes read.
+ */
+static void dev_bcast_consume(dev_file_t *df, u32 length);
+
+/**
+ * @brief Set channel broadcast mode (IOCTL_BROADCAST).
+ * 
+ * Data queued by previous broadcast mode is dropped.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] mode - given BCAST_* mode.
+ * @return 0 - in case of success.
+ * @return -EINVAL - in case of unknown mode.
+ * @return -EBUSY - if data for the shared reader is queued.
+ */
+static long dev_bcast_set(dev_channel_t *ch, unsigned long mode);
+
+/**
+ * @brief Update last operation info with current process.
+ * 
+ * @param [out] info - given last read or write operation info.
+ */
+static inline void dev_op_info_update(dev_op_info_t *info);
+
+/**
+ * @brief Aggregate per-CPU channel statistics.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [out] sum - given structure to store sums (maximum for max_used).
+ */
+static void dev_stats_sum(dev_channel_t *ch, dev_stats_t *sum);
+
+/**
+ * @brief Show current ring buffer occupancy (sysfs).
+ * 
+ * @param [in] dev - given channel device.
+ * @param [in] attr - given device attribute.
+ * @param [out] buf - given output buffer.
+ * @return number of bytes written to the buffer.
+ */
+static ssize_t used_show(struct device *dev, struct device_attribute *attr, char *buf);
+
+/**
+ * @brief Show ring buffer size (sysfs).
+ * 
+ * @param [in] dev - given channel device.
+ * @param [in] attr - given device attribute.
+ * @param [out] buf - given output buffer.
+ * @return number of bytes written to the buffer.
+ */
+static ssize_t size_show(struct device *dev, struct device_attribute *attr, char *buf);
+
+/**
+ * @brief Resize ring buffer (sysfs).
+ * 
+ * @param [in] dev - given channel device.
+ * @param [in] attr - given device attribute.
+ * @param [in] buf - given new size string.
+ * @param [in] count - given string length.
+ * @return count - in case of success.
+ * @return negative number in case of error.
+ */
+static ssize_t size_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+
+/**
+ * @brief Show busy-poll time in microseconds (sysfs).
+ * 
+ * @param [in] dev - given channel device.
+ * @param [in] attr - given device attribute.
+ * @param [out] buf - given output buffer.
+ * @return number of bytes written to the buffer.
+ */
+static ssize_t busy_poll_show(struct device *dev, struct device_attribute *attr, char *buf);
+
+/**
+ * @brief Set busy-poll time in microseconds (sysfs).
+ * 
+ * @param [in] dev - given channel device.
+ * @param [in] attr - given device attribute.
+ * @param [in] buf - given time string.
+ * @param [in] count - given string length.
+ * @return count - in case of success.
+ * @return negative number in case of error.
+ */
+static ssize_t busy_poll_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+
+/**
+ * @brief Show NUMA placement of ring buffer (sysfs).
+ * 
+ * @param [in] dev - given channel device.
+ * @param [in] attr - given device attribute.
+ * @param [out] buf - given output buffer.
+ * @return number of bytes written to the buffer.
+ */
+static ssize_t numa_node_show(struct device *dev, struct device_attribute *attr, char *buf);
+
+/**
+ * @brief Set NUMA placement of ring buffer (sysfs).
+ * 
+ * @param [in] dev - given channel device.
+ * @param [in] attr - given device attribute.
+ * @param [in] buf - given node string (-1 - local, -2 - first reader).
+ * @param [in] count - given string length.
+ * @return count - in case of success.
+ * @return negative number in case of error.
+ */
+static ssize_t numa_node_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count);
+
+/**
+ * @brief Show channel statistics (debugfs).
+ * 
+ * @param [in] s - given sequence file.
+ * @param [in] unused - given unused iterator.
+ * @return 0.
+ */
+static s32 dev_stats_show(struct seq_file *s, void *unused);
+
+/**
+ * @brief Get latency histogram bucket of value.
+ * 
+ * @param [in] value - given latency in nanoseconds.
+ * @return bucket index (see dev_hist_t).
+ */
+static inline u32 dev_hist_bucket(u64 value);
+
+/**
+ * @brief Get lower bound of latency histogram bucket.
+ * 
+ * @param [in] bucket - given bucket index.
+ * @return smallest value in nanoseconds that falls into the bucket.
+ */
+static u64 dev_hist_lower(u32 bucket);
+
+/**
+ * @brief Record latency if histograms are enabled.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] type - given histogram type (LAT_*).
+ * @param [in] value - given latency in nanoseconds.
+ */
+static inline void dev_hist_record(dev_channel_t *ch, u32 type, u64 value);
+
+/**
+ * @brief Aggregate per-CPU latency histogram.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] type - given histogram type (LAT_*).
+ * @param [out] counts - given array of LAT_BUCKETS counters to store sums.
+ */
+static void dev_hist_sum(dev_channel_t *ch, u32 type, u64 *counts);
+
+/**
+ * @brief Reset all latency histograms of channel.
+ * 
+ * @param [in] ch - given device channel.
+ */
+static void dev_hist_reset(dev_channel_t *ch);
+
+/**
+ * @brief Remember enqueue time of a write (write_lock held).
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] index - given ring buffer head after the write.
+ */
+static void dev_stamp_push(dev_channel_t *ch, u32 index);
+
+/**
+ * @brief Record residence latency of completely consumed writes (read_lock held).
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] index - given ring buffer tail after the read.
+ */
+static void dev_stamp_pop(dev_channel_t *ch, u32 index);
+
+/**
+ * @brief Show channel latency histograms & percentiles (debugfs).
+ * 
+ * @param [in] s - given sequence file.
+ * @param [in] unused - given unused iterator.
+ * @return 0 - in case of success.
+ * @return -ENOMEM - in case of out of memory.
+ */
+static s32 dev_hist_show(struct seq_file *s, void *unused);
+
+/**
+ * @brief Open latency histograms debugfs file.
+ * 
+ * @param [in] inode - given inode structure.
+ * @param [in] file - given file structure.
+ * @return 0 - in case of success.
+ */
+static s32 dev_hist_open(struct inode *inode, struct file *file);
+
+/**
+ * @brief Reset latency histograms on any write to debugfs file.
+ * 
+ * @param [in] file - given file structure.
+ * @param [in] buffer - given unused user buffer.
+ * @param [in] length - given buffer length.
+ * @param [in] offset - given unused file offset.
+ * @return length.
+ */
+static ssize_t dev_hist_write(struct file *file, const char __user *buffer, size_t length, loff_t *offset);
+
 /**
  * @brief Open function for character device.
  * 
+ * Sets file private data to per file state for the channel of the opened minor.
+ * 
  * @param [in] inode - given inode structure.
  * @param [in] file - given file structure.
  * @return 0 - in case of success. 
- * @return -1 - in case of error. 
+ * @return -ENOMEM - in case of out of memory. 
  */
 static s32 dev_open(struct inode *inode, struct file *file);
 
@@ -86,27 +1026,267 @@ static s32 dev_open(struct inode *inode, struct file *file);
  */
 static s32 dev_release(struct inode *inode, struct file *file);
 
+/**
+ * @brief Transfer data from the channel ring buffer.
+ * 
+ * Caller holds read side lock (file lock of broadcast reader). In byte stream
+ * mode transfers as much data as available, in message mode exactly one message.
+ * 
+ * Reader of overwrite mode channel gets -EOVERFLOW once after data was
+ * dropped, the gap is added to lost bytes of the file (of the channel
+ * for kernel consumer, see ldrv_lost()).
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] df - given opened file or NULL for kernel consumer.
+ * @param [in] reader - given broadcast reader or NULL for the shared tail.
+ * @param [out] to - given destination iterator.
+ * @param [in,out] timeout - given max wait time in jiffies (0 - do not wait), set to remaining time.
+ * @return number of bytes read on success.
+ * @return -EMSGSIZE - if message is larger than the destination (message is kept).
+ * @return -EOVERFLOW - if reader lost data (broadcast reader skips to the newest data).
+ * @return negative number in case of other error. 
+ */
+static ssize_t dev_read_locked(dev_channel_t *ch, dev_file_t *df, dev_file_t *reader, struct iov_iter *to, long *timeout);
+
+/**
+ * @brief Reserve channel ring buffer slot for a message (see ring_reserve()).
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] need - given slot size (padded header & payload).
+ * @param [out] index - given pointer to store slot index.
+ * @return true - if slot was reserved.
+ * @return false - if there is not enough free space.
+ */
+static bool dev_ring_reserve(dev_channel_t *ch, u32 need, u32 *index);
+
+/**
+ * @brief Transfer message to the channel ring buffer in multi-producer mode.
+ * 
+ * Caller holds resize_sem only. Writer reserves a slot, copies the
+ * message in without lock and commits it, so each write is atomic.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] from - given source iterator.
+ * @param [in,out] timeout - given max wait time in jiffies (0 - do not wait), set to remaining time.
+ * @return number of bytes written on success.
+ * @return -EMSGSIZE - if message can never fit into the ring buffer.
+ * @return negative number in case of other error. 
+ */
+static ssize_t dev_write_reserve(dev_channel_t *ch, struct iov_iter *from, long *timeout);
+
+/**
+ * @brief Set channel multi-producer mode (IOCTL_MP_MODE).
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] enable - given 1 to enable or 0 to disable.
+ * @return 0 - in case of success or if mode is already set.
+ * @return -EINVAL - if channel is not in message mode or is lossy.
+ * @return -EBUSY - if ring buffer is not empty or is used by kernel API.
+ */
+static long dev_mp_set(dev_channel_t *ch, unsigned long enable);
+
+/**
+ * @brief Set channel priority lanes (IOCTL_LANES).
+ * 
+ * Lanes have the size of the channel ring buffer. Weights
+ * may be changed at any time, number of lanes only while
+ * lanes 1 and higher are empty & have no blocked writers.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] arg - given user space lanes configuration.
+ * @return 0 - in case of success.
+ * @return -EINVAL - in case of incorrect number of lanes or broadcast, multi-producer or overwrite mode.
+ * @return -ENOMEM - in case of out of memory.
+ * @return -EBUSY - if ring buffer is mapped or lanes are in use.
+ */
+static long dev_lanes_set(dev_channel_t *ch, dev_lanes_t __user *arg);
+
+/**
+ * @brief Transfer data to the channel ring buffer.
+ * 
+ * Caller holds write side lock of the lane. In byte stream mode transfers as 
+ * much data as fits, in message mode the whole source as one message.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] lane - given priority lane (0 in multi-producer mode).
+ * @param [in] from - given source iterator.
+ * @param [in,out] timeout - given max wait time in jiffies (0 - do not wait), set to remaining time.
+ * @return number of bytes written on success.
+ * @return -EMSGSIZE - if message can never fit into the ring buffer.
+ * @return negative number in case of other error. 
+ */
+static ssize_t dev_write_locked(dev_channel_t *ch, u32 lane, struct iov_iter *from, long *timeout);
+
 /**
  * @brief Read data from the character device.
  *
- * @param [in] file - given file structure.
- * @param [out] buffer - given buffer to store the read data.
- * @param [in] length - given number of bytes to read.
- * @param [in] offset - given file offset.
+ * Works like a pipe: returns at most the number of bytes currently 
+ * stored in the ring buffer (short read). Blocks only if the ring buffer
+ * is empty and file is not O_NONBLOCK, otherwise returns -EAGAIN.
+ * Returns -ETIMEDOUT if read timeout of the file expired.
+ * In message mode returns exactly one message.
+ * Serves read(), readv() and io_uring read operations.
+ *
+ * @param [in] iocb - given I/O control block.
+ * @param [out] to - given iterator over the buffers to store the read data.
  * @return Number of bytes read on success, or an error code on failure.
  */
-static ssize_t dev_read(struct file *file, char *buffer, size_t length, loff_t *offset);
+static ssize_t dev_read_iter(struct kiocb *iocb, struct iov_iter *to);
 
 /**
  * @brief Write data to the character device.
  *
- * @param [in] file - given file structure.
- * @param [in] buffer - given buffer of data to be written.
- * @param [in] length - given number of bytes to write.
- * @param [in] offset - given file offset.
+ * Works like a pipe: writes at most the number of bytes currently 
+ * free in the ring buffer (short write). Blocks only if the ring buffer
+ * is full and file is not O_NONBLOCK, otherwise returns -EAGAIN.
+ * Returns -ETIMEDOUT if write timeout of the file expired.
+ * In message mode writes the whole buffer as one message.
+ * Serves write(), writev() and io_uring write operations.
+ *
+ * @param [in] iocb - given I/O control block.
+ * @param [in] from - given iterator over the buffers of data to be written.
  * @return Number of bytes written on success, or an error code on failure.
  */
-static ssize_t dev_write(struct file *file, const char *buffer, size_t length, loff_t *offset);
+static ssize_t dev_write_iter(struct kiocb *iocb, struct iov_iter *from);
+
+/**
+ * @brief Send or receive a batch of messages.
+ * 
+ * @param [in] file - given file structure.
+ * @param [in] arg - given user space batch structure.
+ * @param [in] recv - given direction flag.
+ * @return number of transferred messages on success.
+ * @return negative number in case of error. 
+ */
+static long dev_msg_batch(struct file *file, dev_msg_batch_t __user *arg, bool recv);
+
+/**
+ * @brief Poll function for character device.
+ * 
+ * Device is readable if ring buffer is not empty and writable
+ * if ring buffer is not full. Every transition is followed by a 
+ * wake up, so edge-triggered epoll works as well.
+ *
+ * @param [in] file - given file structure.
+ * @param [in] wait - given poll table.
+ * @return mask of ready events.
+ */
+static __poll_t dev_poll(struct file *file, poll_table *wait);
+
+/**
+ * @brief Map ring buffer into user space.
+ * 
+ * Mapping layout: control page (ring_ctrl_t) at offset 0, 
+ * followed by the ring buffer data pages mapped twice, so
+ * records can be parsed in place across the wrap around.
+ *
+ * @param [in] file - given file structure.
+ * @param [in] vma - given virtual memory area.
+ * @return 0 - in case of success. 
+ * @return negative number in case of error. 
+ */
+static s32 dev_mmap(struct file *file, struct vm_area_struct *vma);
+
+/**
+ * @brief Count new mapping of ring buffer (also on fork & split).
+ * 
+ * @param [in] vma - given virtual memory area.
+ */
+static void dev_vm_open(struct vm_area_struct *vma);
+
+/**
+ * @brief Uncount removed mapping of ring buffer.
+ * 
+ * @param [in] vma - given virtual memory area.
+ */
+static void dev_vm_close(struct vm_area_struct *vma);
+
+#ifdef CONFIG_IO_URING
+/**
+ * @brief Try to perform io_uring command without blocking.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] ioucmd - given io_uring command.
+ * @return number of bytes transferred or 0 in case of success. 
+ * @return -EAGAIN - if ring buffer is not ready. 
+ * @return -EBUSY - if side lock or resize_sem is contended. 
+ * @return negative number in case of other error. 
+ */
+static s32 dev_uring_issue(dev_channel_t *ch, struct io_uring_cmd *ioucmd);
+
+/**
+ * @brief Check whether io_uring command can make progress.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] ioucmd - given io_uring command.
+ * @return true - if ring buffer is ready for the command.
+ */
+static bool dev_uring_ready(dev_channel_t *ch, struct io_uring_cmd *ioucmd);
+
+/**
+ * @brief Park io_uring command until the ring buffer is ready.
+ * 
+ * Command that lost the race for the side lock is parked until the lock
+ * is released instead, free space or data do not help it.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] ioucmd - given io_uring command.
+ * @param [in] issue_flags - given io_uring issue flags.
+ * @param [in] contended - given lock contention flag.
+ * @return -EIOCBQUEUED.
+ */
+static s32 dev_uring_park(dev_channel_t *ch, struct io_uring_cmd *ioucmd, u32 issue_flags, bool contended);
+
+/**
+ * @brief Task work callback retrying parked io_uring command.
+ * 
+ * @param [in] ioucmd - given io_uring command.
+ * @param [in] issue_flags - given io_uring issue flags.
+ */
+static void dev_uring_task_cb(struct io_uring_cmd *ioucmd, u32 issue_flags);
+
+/**
+ * @brief io_uring passthrough command handler.
+ * 
+ * Commands that cannot make progress are completed asynchronously
+ * once the peer updates the ring buffer, without blocking a thread.
+ * 
+ * @param [in] ioucmd - given io_uring command.
+ * @param [in] issue_flags - given io_uring issue flags.
+ * @return number of bytes transferred or 0 in case of success. 
+ * @return -EIOCBQUEUED - if command will be completed asynchronously. 
+ * @return negative number in case of error. 
+ */
+static s32 dev_uring_cmd(struct io_uring_cmd *ioucmd, u32 issue_flags);
+#endif /* CONFIG_IO_URING */
+
+/**
+ * @brief Schedule retry of parked io_uring commands.
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in] list - given list of parked commands.
+ */
+static void dev_uring_kick(dev_channel_t *ch, struct list_head *list);
+
+/**
+ * @brief Copy latency histogram to user space (IOCTL_LAT_HIST).
+ * 
+ * @param [in] ch - given device channel.
+ * @param [in,out] arg - given user histogram with type set.
+ * @return 0 - in case of success.
+ * @return -EINVAL - in case of unknown histogram type.
+ * @return -EFAULT - in case of bad user pointer.
+ * @return -ENOMEM - in case of out of memory.
+ */
+static long dev_hist_copy(dev_channel_t *ch, dev_lat_hist_t __user *arg);
+
+/**
+ * @brief Convert timeout set by user space to wait time.
+ * 
+ * @param [in] msecs - given timeout in milliseconds (0 - no timeout).
+ * @return timeout in jiffies.
+ */
+static long dev_timeout(unsigned long msecs);
 
 /**
  * @brief Perform device I/O control operation.
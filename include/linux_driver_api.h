@@ -0,0 +1,130 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/**
+ * @file  linux_driver_api.h
+ * @brief Contains linux driver API for other kernel modules.
+ *
+ * Kernel modules exchange data with user space readers & writers
+ * of a channel without user copies. Data format follows the channel
+ * mode: byte stream or messages (IOCTL_MSG_MODE).
+ */
+
+#ifndef _TEST_TASK_LINUX_DRIVER_API_H_
+#define _TEST_TASK_LINUX_DRIVER_API_H_
+
+#include <linux/types.h>
+#include <linux/uio.h>
+
+/* do not wait for data or free space, return -EAGAIN instead */
+#define LDRV_NOWAIT 0x1
+
+/*
+ * never sleep, callable from atomic & softirq context (implies LDRV_NOWAIT);
+ * supported by enqueue in multi-producer mode (IOCTL_MP_MODE) only,
+ * calls without it are refused in interrupt context
+ */
+#define LDRV_ATOMIC 0x2
+
+struct ldrv_channel;
+
+/**
+ * @brief Get device channel for kernel producer or consumer.
+ *
+ * May sleep. Ring buffer of the channel is not resized until
+ * the channel is released with ldrv_channel_put().
+ *
+ * @param [in] index - given channel index (minor number offset).
+ * @return channel - in case of success.
+ * @return ERR_PTR(-ENODEV) - in case of incorrect index.
+ */
+struct ldrv_channel *ldrv_channel_get(u32 index);
+
+/**
+ * @brief Release device channel.
+ *
+ * @param [in] ch - given device channel.
+ */
+void ldrv_channel_put(struct ldrv_channel *ch);
+
+/**
+ * @brief Enqueue data from kernel memory.
+ *
+ * In byte stream mode transfers as much data as fits,
+ * in message mode the whole buffer as one message.
+ *
+ * @param [in] ch - given device channel.
+ * @param [in] buf - given source buffer.
+ * @param [in] len - given number of bytes.
+ * @param [in] flags - given LDRV_* flags.
+ * @return number of bytes enqueued on success.
+ * @return -EAGAIN - if ring buffer is full and waiting is not allowed.
+ * @return -EINVAL - if LDRV_ATOMIC is used not in multi-producer mode
+ * or is missing in interrupt context.
+ * @return negative number in case of other error.
+ */
+ssize_t ldrv_enqueue(struct ldrv_channel *ch, const void *buf, size_t len, u32 flags);
+
+/**
+ * @brief Enqueue batch of messages from kernel memory.
+ *
+ * Waits only for the first message (unless LDRV_NOWAIT), readers
+ * are woken up once for the whole batch.
+ *
+ * @param [in] ch - given device channel (message mode).
+ * @param [in] vec - given messages.
+ * @param [in] count - given number of messages.
+ * @param [in] flags - given LDRV_* flags.
+ * @return number of messages enqueued on success.
+ * @return negative number in case of error before the first message.
+ */
+int ldrv_enqueue_batch(struct ldrv_channel *ch, const struct kvec *vec, u32 count, u32 flags);
+
+/**
+ * @brief Dequeue data to kernel memory.
+ *
+ * May sleep unless LDRV_NOWAIT is set. There is no non-sleeping
+ * variant: consumers in atomic context defer dequeue to process
+ * context (e.g. a work item). Not supported in broadcast mode.
+ *
+ * In overwrite mode the first dequeue after data was dropped returns
+ * -EOVERFLOW once, the dropped bytes are added to ldrv_lost().
+ *
+ * @param [in] ch - given device channel.
+ * @param [out] buf - given destination buffer.
+ * @param [in] len - given buffer size.
+ * @param [in] flags - given LDRV_* flags.
+ * @return number of bytes dequeued on success.
+ * @return -EAGAIN - if ring buffer is empty and waiting is not allowed.
+ * @return -EMSGSIZE - if message is larger than the buffer (message is kept).
+ * @return -EOVERFLOW - if data was dropped since the previous dequeue (retry to get newer data).
+ * @return -EINVAL - if LDRV_ATOMIC is set, in interrupt context or in broadcast mode.
+ * @return negative number in case of other error.
+ */
+ssize_t ldrv_dequeue(struct ldrv_channel *ch, void *buf, size_t len, u32 flags);
+
+/**
+ * @brief Get number of bytes kernel consumers lost to overwrites.
+ *
+ * Counterpart of IOCTL_LOST for ldrv_dequeue(), the total since
+ * the driver was loaded.
+ *
+ * @param [in] ch - given device channel.
+ * @return number of lost bytes.
+ */
+u64 ldrv_lost(struct ldrv_channel *ch);
+
+#endif /* _TEST_TASK_LINUX_DRIVER_API_H_ */
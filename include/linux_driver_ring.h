@@ -0,0 +1,617 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/**
+ * @file  linux_driver_ring.h
+ * @brief Contains ring buffer core of linux driver.
+ *
+ * Ring buffer memory, indices & copies, message framing, lossy drop
+ * and multi-producer slot reservation, without channel state (locks,
+ * wait queues, modes, statistics). Shared by the driver and its KUnit
+ * suite (test/kunit/), which runs without loading the driver.
+ */
+
+#ifndef _TEST_TASK_LINUX_DRIVER_RING_H_
+#define _TEST_TASK_LINUX_DRIVER_RING_H_
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/compiler.h>
+#include <linux/minmax.h>
+#include <linux/numa.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/uio.h>
+#include <asm/barrier.h>
+
+/* alignment of the ring buffer control structure fields shared with user space */
+#define RING_CTRL_ALIGN 128
+
+/* size of the message length header preceding each message in message mode */
+#define RING_MSG_HDR sizeof(u32)
+
+/* header flag of a message slot reserved but not committed by multi-producer writer */
+#define RING_MSG_BUSY (1U << 31)
+
+/* header flag of a committed slot whose message was not copied in, it is read as an empty message */
+#define RING_MSG_SKIP (1U << 30)
+
+/**
+ * @brief Ring buffer control structure.
+ * 
+ * Located in a separate page, which can be mapped into
+ * user space together with the data pages (see dev_mmap()).
+ * 
+ * Head and tail are free-running indices, their difference is the
+ * number of bytes stored in the buffer. Size is always a power of two,
+ * so the position of an index inside the data array is obtained by 
+ * masking it with (size - 1).
+ * 
+ * Head is written only by the writer and tail only by the reader.
+ * Each index is published with release and observed by the other
+ * side with acquire ordering, so one reader and one writer need
+ * no lock. Indices live on separate cache lines to avoid false sharing.
+ * 
+ * Waiters counters are the number of tasks sleeping in the driver
+ * for data or for free space. User space side that advances an index
+ * must issue IOCTL_WAKE if the peer counter is not zero.
+ */
+typedef struct {
+    u32      size;
+    u32      head          __aligned(RING_CTRL_ALIGN); /* write index */
+    atomic_t write_waiters;
+    u32      tail          __aligned(RING_CTRL_ALIGN); /* read index */
+    atomic_t read_waiters;
+} ring_ctrl_t;
+
+/**
+ * @brief Ring buffer structure.
+ * 
+ * Data pages are mapped twice back to back (in kernel and in user space),
+ * so any region of up to size bytes starting anywhere in the ring buffer
+ * is contiguous and is copied at once. Size is at least PAGE_SIZE.
+ * Kernel keeps its own copy of size, since the control page
+ * is writable from user space.
+ */
+typedef struct {
+    ring_ctrl_t  *ctrl;
+    char         *data;   /* mirrored mapping of 2 * size bytes */
+    struct page **pages;  /* data pages */
+    u32           size;
+    int           node;   /* NUMA node data pages were allocated on, NUMA_NO_NODE - local */
+} ring_buffer_t;
+
+/**
+ * @brief Get number of bytes stored in the ring buffer.
+ * 
+ * Reader side view: head is loaded with acquire ordering,
+ * so the data before head is visible to the caller.
+ * Result is clamped to the ring buffer size, since indices
+ * may be corrupted by user space through the shared mapping.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @return number of bytes available for reading.
+ */
+static inline u32 ring_used(const ring_buffer_t *rb)
+{
+    u32 head, tail;
+
+    /* pairs with release of head in ring_produce() */
+    head = smp_load_acquire(&rb->ctrl->head);
+    tail = READ_ONCE(rb->ctrl->tail);
+
+    return umin(head - tail, rb->size);
+}
+
+/**
+ * @brief Get number of free bytes in the ring buffer.
+ * 
+ * Writer side view: tail is loaded with acquire ordering,
+ * so the reader has finished with the space before tail.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @return number of bytes available for writing.
+ */
+static inline u32 ring_free(const ring_buffer_t *rb)
+{
+    u32 head, tail;
+
+    /* pairs with release of tail in ring_consume() */
+    tail = smp_load_acquire(&rb->ctrl->tail);
+    head = READ_ONCE(rb->ctrl->head);
+
+    return rb->size - umin(head - tail, rb->size);
+}
+
+/**
+ * @brief Advance tail by length bytes (with release ordering).
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] length - given number of bytes consumed.
+ */
+static inline void ring_consume(ring_buffer_t *rb, u32 length)
+{
+    /* hand the space over to the writer after data was copied out */
+    smp_store_release(&rb->ctrl->tail, READ_ONCE(rb->ctrl->tail) + length);
+}
+
+/**
+ * @brief Advance head by length bytes (with release ordering).
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] length - given number of bytes produced.
+ */
+static inline void ring_produce(ring_buffer_t *rb, u32 length)
+{
+    /* publish data to the reader after it was copied in */
+    smp_store_release(&rb->ctrl->head, READ_ONCE(rb->ctrl->head) + length);
+}
+
+/**
+ * @brief Move tail of broadcast overrun ring buffer before overwriting data.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] end - given head index after the write.
+ */
+static inline void ring_overwrite(ring_buffer_t *rb, u32 end)
+{
+    u32 tail = READ_ONCE(rb->ctrl->tail);
+
+    if ((s32)(end - rb->size - tail) <= 0)
+        return;
+
+    /* oldest data is dropped before it is overwritten, readers check tail after copying */
+    WRITE_ONCE(rb->ctrl->tail, end - rb->size);
+    smp_wmb();
+}
+
+/**
+ * @brief Copy data from the ring buffer to kernel memory.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] index - given ring buffer index to copy from.
+ * @param [out] dst - given destination.
+ * @param [in] length - given number of bytes to copy.
+ */
+static inline void ring_get(const ring_buffer_t *rb, u32 index, void *dst, u32 length)
+{
+    memcpy(dst, rb->data + (index & (rb->size - 1)), length);
+}
+
+/**
+ * @brief Copy data from kernel memory to the ring buffer.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] index - given ring buffer index to copy to.
+ * @param [in] src - given source.
+ * @param [in] length - given number of bytes to copy.
+ */
+static inline void ring_put(ring_buffer_t *rb, u32 index, const void *src, u32 length)
+{
+    memcpy(rb->data + (index & (rb->size - 1)), src, length);
+}
+
+/**
+ * @brief Copy data from the ring buffer to I/O vector iterator.
+ * 
+ * Data is contiguous thanks to the mirrored mapping, it
+ * can be scattered among several user space segments.
+ * Indices are not changed, see ring_consume().
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] index - given ring buffer index to copy from.
+ * @param [out] iter - given destination iterator.
+ * @param [in] length - given number of bytes to copy (not greater than ring_used()).
+ * @return number of bytes copied (less than length in case of fault).
+ */
+static inline u32 ring_copy_to_iter(const ring_buffer_t *rb, u32 index, struct iov_iter *iter, u32 length)
+{
+    /* mirrored mapping: no split at the end of the data array */
+    return copy_to_iter(rb->data + (index & (rb->size - 1)), length, iter);
+}
+
+/**
+ * @brief Copy data from I/O vector iterator to the ring buffer.
+ * 
+ * Data is contiguous thanks to the mirrored mapping, it
+ * can be gathered from several user space segments.
+ * Indices are not changed, see ring_produce().
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] index - given ring buffer index to copy to.
+ * @param [in] iter - given source iterator.
+ * @param [in] length - given number of bytes to copy (not greater than ring_free()).
+ * @return number of bytes copied (less than length in case of fault).
+ */
+static inline u32 ring_copy_from_iter(ring_buffer_t *rb, u32 index, struct iov_iter *iter, u32 length)
+{
+    /* mirrored mapping: no split at the end of the data array */
+    return copy_from_iter(rb->data + (index & (rb->size - 1)), length, iter);
+}
+
+/**
+ * @brief Get number of bytes taken by a message in the ring buffer.
+ * 
+ * @param [in] length - given message length.
+ * @param [in] padded - given flag of multi-producer slot padded to the header size.
+ * @return header & payload size.
+ */
+static inline u32 ring_msg_size(u32 length, bool padded)
+{
+    return RING_MSG_HDR + (padded ? ALIGN(length, RING_MSG_HDR) : length);
+}
+
+/**
+ * @brief Check whether message can ever fit into the ring buffer.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] length - given message length.
+ * @return true - if message fits into the empty ring buffer.
+ * @return false - if write of the message fails with -EMSGSIZE.
+ */
+static inline bool ring_msg_fits(const ring_buffer_t *rb, size_t length)
+{
+    return length <= rb->size - RING_MSG_HDR;
+}
+
+/**
+ * @brief Get message header of a ring buffer slot (multi-producer mode).
+ * 
+ * Slots are padded to the header size, so header is never split by wrap around.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] index - given slot index.
+ * @return pointer to the header.
+ */
+static inline u32 *ring_hdr(const ring_buffer_t *rb, u32 index)
+{
+    return (u32 *)(rb->data + (index & (rb->size - 1)));
+}
+
+/**
+ * @brief Get message length from the header at index.
+ * 
+ * Length is not validated, see ring_read_msg().
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] index - given message index.
+ * @return message length.
+ */
+static inline u32 ring_msg_len(const ring_buffer_t *rb, u32 index)
+{
+    u32 msg_len;
+
+    ring_get(rb, index, &msg_len, RING_MSG_HDR);
+    return msg_len;
+}
+
+/**
+ * @brief Copy byte stream data from the ring buffer to I/O vector iterator.
+ * 
+ * Indices are not changed, see ring_consume().
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] tail - given index to read from.
+ * @param [in] used - given number of bytes available at tail (not 0).
+ * @param [out] to - given destination iterator.
+ * @return number of bytes copied, less than requested in case of less data (short read).
+ * @return -EFAULT - if nothing was copied.
+ */
+static inline ssize_t ring_read_stream(const ring_buffer_t *rb, u32 tail, u32 used, struct iov_iter *to)
+{
+    u32 copied;
+
+    copied = ring_copy_to_iter(rb, tail, to, umin(iov_iter_count(to), used));
+
+    return copied ? copied : -EFAULT;
+}
+
+/**
+ * @brief Copy byte stream data from I/O vector iterator to the ring buffer.
+ * 
+ * Indices are not changed, see ring_produce().
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] head - given index to write to.
+ * @param [in] avail - given number of bytes free at head (not 0).
+ * @param [in] from - given source iterator.
+ * @return number of bytes copied, less than requested in case of less free space (short write).
+ * @return -EFAULT - if nothing was copied.
+ */
+static inline ssize_t ring_write_stream(ring_buffer_t *rb, u32 head, u32 avail, struct iov_iter *from)
+{
+    u32 copied;
+
+    copied = ring_copy_from_iter(rb, head, from, umin(iov_iter_count(from), avail));
+
+    return copied ? copied : -EFAULT;
+}
+
+/**
+ * @brief Copy message at tail to I/O vector iterator.
+ * 
+ * Whole message is copied or nothing. Indices are not changed,
+ * caller consumes the returned number of bytes.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] tail - given message index.
+ * @param [in] used - given number of bytes available at tail.
+ * @param [in] msg_len - given message length read from the header (see ring_msg_len()).
+ * @param [out] to - given destination iterator.
+ * @param [in] padded - given flag of multi-producer slots padded to the header size.
+ * @param [out] consumed - given pointer to store number of bytes taken by the message.
+ * @return message length on success (0 for a skipped slot).
+ * @return -EIO - if message is corrupted (does not fit into used bytes).
+ * @return -EMSGSIZE - if message is larger than the destination (nothing is copied).
+ * @return -EFAULT - if message was copied partially.
+ */
+static inline ssize_t ring_read_msg(const ring_buffer_t *rb, u32 tail, u32 used, u32 msg_len,
+                                    struct iov_iter *to, bool padded, u32 *consumed)
+{
+    u32 copied, length;
+
+    length = msg_len & ~RING_MSG_SKIP;
+
+    /* writer publishes header & payload at once, so only a corrupted message is incomplete */
+    if (used < RING_MSG_HDR || length > used - RING_MSG_HDR)
+        return -EIO;
+
+    /* slot of a failed multi-producer copy is consumed whole */
+    if (msg_len & RING_MSG_SKIP) {
+        *consumed = ring_msg_size(length, padded);
+        return 0;
+    }
+
+    /* message is left in the ring buffer for a read with larger buffer */
+    if (msg_len > iov_iter_count(to))
+        return -EMSGSIZE;
+
+    copied = ring_copy_to_iter(rb, tail + RING_MSG_HDR, to, msg_len);
+
+    if (copied != msg_len)
+        return -EFAULT;
+
+    /* multi-producer messages are padded, so headers are never split */
+    *consumed = ring_msg_size(msg_len, padded);
+    return copied;
+}
+
+/**
+ * @brief Copy the whole source iterator to the ring buffer as one message.
+ * 
+ * Caller checked ring_msg_fits() and free space for ring_msg_size().
+ * Indices are not changed, message is published by ring_produce().
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] head - given index to write header to.
+ * @param [in] from - given source iterator.
+ * @return message length on success.
+ * @return -EFAULT - if message was copied partially (it must not be published).
+ */
+static inline ssize_t ring_write_msg(ring_buffer_t *rb, u32 head, struct iov_iter *from)
+{
+    u32 msg_len = iov_iter_count(from);
+    u32 copied;
+
+    ring_put(rb, head, &msg_len, RING_MSG_HDR);
+    copied = ring_copy_from_iter(rb, head + RING_MSG_HDR, from, msg_len);
+
+    return copied == msg_len ? copied : -EFAULT;
+}
+
+/**
+ * @brief Drop the oldest data until need bytes are free (overwrite mode).
+ * 
+ * Caller serializes writers. Tail is moved with cmpxchg, so a reader
+ * that consumed data meanwhile wins and the drop is recomputed.
+ * In message mode whole messages are dropped, corrupted header drops
+ * everything.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] need - given number of bytes to free (at most size).
+ * @param [in] msg_mode - given flag to drop whole messages.
+ * @param [out] msgs - given pointer to store number of dropped messages.
+ * @return number of dropped bytes.
+ */
+static inline u32 ring_drop(ring_buffer_t *rb, u32 need, bool msg_mode, u32 *msgs)
+{
+    u32 head, tail, used, drop, msg_len;
+    u32 bytes = 0;
+
+    head  = READ_ONCE(rb->ctrl->head);
+    *msgs = 0;
+
+    for (;;) {
+        tail = smp_load_acquire(&rb->ctrl->tail);
+        used = head - tail;
+
+        if (used <= rb->size - need)
+            break;
+
+        drop = used - (rb->size - need);
+
+        if (msg_mode) {
+            msg_len = ring_msg_len(rb, tail);
+            drop    = msg_len > used - RING_MSG_HDR ? used : RING_MSG_HDR + msg_len;
+        }
+
+        /* tail is moved before data is overwritten, reader that consumed meanwhile wins */
+        if (cmpxchg(&rb->ctrl->tail, tail, tail + drop) != tail)
+            continue;
+
+        bytes += drop;
+        *msgs += msg_mode;
+    }
+
+    return bytes;
+}
+
+/**
+ * @brief Reserve ring buffer slot for a message (multi-producer mode).
+ * 
+ * Caller serializes reservations (only free space check & index update),
+ * data is copied into the slot without lock. Slot header is marked
+ * RING_MSG_BUSY until ring_commit().
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in,out] reserve - given reservation index (head of reserved slots).
+ * @param [in] need - given slot size (see ring_msg_size()).
+ * @param [out] index - given pointer to store slot index.
+ * @return true - if slot was reserved.
+ * @return false - if there is not enough free space.
+ */
+static inline bool ring_reserve(ring_buffer_t *rb, u32 *reserve, u32 need, u32 *index)
+{
+    if (rb->size - (*reserve - smp_load_acquire(&rb->ctrl->tail)) < need)
+        return false;
+
+    *index = *reserve;
+
+    /* slot is skipped by ring_commit() until its writer clears the flag */
+    WRITE_ONCE(*ring_hdr(rb, *index), RING_MSG_BUSY);
+    smp_wmb();
+    WRITE_ONCE(*reserve, *index + need);
+    return true;
+}
+
+/**
+ * @brief Commit reserved slot and publish all committed slots in reservation order.
+ * 
+ * Any committing writer moves head over the slots committed before,
+ * so head never passes a slot which is still copied in.
+ * 
+ * @param [in] rb - given ring buffer.
+ * @param [in] reserve - given reservation index.
+ * @param [in] index - given slot index.
+ * @param [in] length - given message length, with RING_MSG_SKIP if it was not copied in.
+ */
+static inline void ring_commit(ring_buffer_t *rb, const u32 *reserve, u32 index, u32 length)
+{
+    u32 head, end, msg_len, size;
+
+    /* length is published after data and clears busy flag */
+    smp_store_release(ring_hdr(rb, index), length);
+
+    /* either earlier writer sees this slot committed or this writer sees its slot */
+    smp_mb();
+
+    for (;;) {
+        head = READ_ONCE(rb->ctrl->head);
+        end  = READ_ONCE(*reserve);
+
+        if (head == end)
+            break;
+
+        /* pairs with smp_wmb() in ring_reserve(): header is written before reservation */
+        smp_rmb();
+        msg_len = smp_load_acquire(ring_hdr(rb, head));
+
+        /* slot is still copied in, its writer continues from here */
+        if (msg_len & RING_MSG_BUSY)
+            break;
+
+        size = ring_msg_size(msg_len & ~RING_MSG_SKIP, true);
+
+        if (size > end - head)
+            break;
+
+        cmpxchg(&rb->ctrl->head, head, head + size);
+    }
+}
+
+/**
+ * @brief Free ring buffer memory (also partially allocated).
+ * 
+ * @param [in] rb - given ring buffer.
+ */
+static inline void ring_destroy(ring_buffer_t *rb)
+{
+    u32 i;
+
+    if (rb->data)
+        vunmap(rb->data);
+
+    if (rb->pages) {
+        for (i = 0; i < rb->size >> PAGE_SHIFT; i++) {
+            if (rb->pages[i])
+                __free_page(rb->pages[i]);
+        }
+    }
+
+    kvfree(rb->pages);
+    vfree(rb->ctrl);
+
+    rb->ctrl  = NULL;
+    rb->data  = NULL;
+    rb->pages = NULL;
+}
+
+/**
+ * @brief Allocate ring buffer memory.
+ * 
+ * Control page and data pages are zeroed & suitable for mapping to user space.
+ * 
+ * @param [out] rb - given ring buffer.
+ * @param [in] size - given data size (power of two, at least PAGE_SIZE).
+ * @param [in] node - given preferred NUMA node of data pages (NUMA_NO_NODE - local).
+ * @return 0 - in case of success. 
+ * @return -ENOMEM - in case of memory allocation error. 
+ */
+static inline s32 ring_alloc(ring_buffer_t *rb, u32 size, int node)
+{
+    struct page **map;
+    u32 pages = size >> PAGE_SHIFT;
+    u32 i;
+
+    rb->size  = size;
+    rb->node  = node;
+    rb->data  = NULL;
+    rb->ctrl  = vmalloc_user(PAGE_SIZE);
+    rb->pages = kvcalloc(pages, sizeof(struct page *), GFP_KERNEL);
+    map       = kvmalloc_array(2 * pages, sizeof(struct page *), GFP_KERNEL);
+
+    if (!rb->ctrl || !rb->pages || !map)
+        goto fail;
+
+    for (i = 0; i < pages; i++) {
+        /* zeroed, as data pages are mapped to user space */
+        rb->pages[i] = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO, 0);
+
+        if (!rb->pages[i])
+            goto fail;
+
+        map[i] = map[pages + i] = rb->pages[i];
+    }
+
+    /* second copy of the pages follows the first one, so wrap around is contiguous */
+    rb->data = vmap(map, 2 * pages, VM_MAP, PAGE_KERNEL);
+
+    if (!rb->data)
+        goto fail;
+
+    kvfree(map);
+    rb->ctrl->size = size;
+    return 0;
+
+fail:
+    kvfree(map);
+    ring_destroy(rb);
+    return -ENOMEM;
+}
+
+#endif /* _TEST_TASK_LINUX_DRIVER_RING_H_ */
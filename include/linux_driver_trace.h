@@ -0,0 +1,167 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/**
+ * @file  linux_driver_trace.h
+ * @brief Contains linux driver tracepoints.
+ *
+ * Tracepoints cost nothing while disabled. To enable them run:
+ * echo 1 > /sys/kernel/tracing/events/linux_driver/enable
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM linux_driver
+
+#if !defined(_TEST_TASK_LINUX_DRIVER_TRACE_H_) || defined(TRACE_HEADER_MULTI_READ)
+#define _TEST_TASK_LINUX_DRIVER_TRACE_H_
+
+#include <linux/tracepoint.h>
+
+/* open/release of channel file */
+DECLARE_EVENT_CLASS(ldrv_file,
+    TP_PROTO(u32 channel),
+    TP_ARGS(channel),
+
+    TP_STRUCT__entry(
+        __field(u32, channel)
+        __field(uid_t, uid)
+    ),
+
+    TP_fast_assign(
+        __entry->channel = channel;
+        __entry->uid     = from_kuid(&init_user_ns, current_uid());
+    ),
+
+    TP_printk("channel=%u uid=%u", __entry->channel, __entry->uid)
+);
+
+DEFINE_EVENT(ldrv_file, ldrv_open,
+    TP_PROTO(u32 channel),
+    TP_ARGS(channel)
+);
+
+DEFINE_EVENT(ldrv_file, ldrv_release,
+    TP_PROTO(u32 channel),
+    TP_ARGS(channel)
+);
+
+/* completed read/write: requested & transferred bytes (or error), ring buffer occupancy */
+DECLARE_EVENT_CLASS(ldrv_io,
+    TP_PROTO(u32 channel, size_t requested, ssize_t ret, u32 used),
+    TP_ARGS(channel, requested, ret, used),
+
+    TP_STRUCT__entry(
+        __field(u32, channel)
+        __field(size_t, requested)
+        __field(ssize_t, ret)
+        __field(u32, used)
+    ),
+
+    TP_fast_assign(
+        __entry->channel   = channel;
+        __entry->requested = requested;
+        __entry->ret       = ret;
+        __entry->used      = used;
+    ),
+
+    TP_printk("channel=%u requested=%zu ret=%zd used=%u",
+              __entry->channel, __entry->requested, __entry->ret, __entry->used)
+);
+
+DEFINE_EVENT(ldrv_io, ldrv_read,
+    TP_PROTO(u32 channel, size_t requested, ssize_t ret, u32 used),
+    TP_ARGS(channel, requested, ret, used)
+);
+
+DEFINE_EVENT(ldrv_io, ldrv_write,
+    TP_PROTO(u32 channel, size_t requested, ssize_t ret, u32 used),
+    TP_ARGS(channel, requested, ret, used)
+);
+
+TRACE_EVENT(ldrv_ioctl,
+    TP_PROTO(u32 channel, u32 cmd, unsigned long arg, long ret),
+    TP_ARGS(channel, cmd, arg, ret),
+
+    TP_STRUCT__entry(
+        __field(u32, channel)
+        __field(u32, cmd)
+        __field(unsigned long, arg)
+        __field(long, ret)
+    ),
+
+    TP_fast_assign(
+        __entry->channel = channel;
+        __entry->cmd     = cmd;
+        __entry->arg     = arg;
+        __entry->ret     = ret;
+    ),
+
+    TP_printk("channel=%u cmd=0x%x arg=0x%lx ret=%ld",
+              __entry->channel, __entry->cmd, __entry->arg, __entry->ret)
+);
+
+/* finished sleep of reader (write=0) or writer (write=1) */
+TRACE_EVENT(ldrv_wait,
+    TP_PROTO(u32 channel, bool write, u32 count, u64 duration_ns, s32 ret),
+    TP_ARGS(channel, write, count, duration_ns, ret),
+
+    TP_STRUCT__entry(
+        __field(u32, channel)
+        __field(bool, write)
+        __field(u32, count)
+        __field(u64, duration_ns)
+        __field(s32, ret)
+    ),
+
+    TP_fast_assign(
+        __entry->channel     = channel;
+        __entry->write       = write;
+        __entry->count       = count;
+        __entry->duration_ns = duration_ns;
+        __entry->ret         = ret;
+    ),
+
+    TP_printk("channel=%u side=%s count=%u duration_ns=%llu ret=%d",
+              __entry->channel, __entry->write ? "write" : "read",
+              __entry->count, __entry->duration_ns, __entry->ret)
+);
+
+/* wake up of sleeping readers (write=0) or writers (write=1) */
+TRACE_EVENT(ldrv_wake,
+    TP_PROTO(u32 channel, bool write),
+    TP_ARGS(channel, write),
+
+    TP_STRUCT__entry(
+        __field(u32, channel)
+        __field(bool, write)
+    ),
+
+    TP_fast_assign(
+        __entry->channel = channel;
+        __entry->write   = write;
+    ),
+
+    TP_printk("channel=%u side=%s", __entry->channel, __entry->write ? "write" : "read")
+);
+
+#endif /* _TEST_TASK_LINUX_DRIVER_TRACE_H_ */
+
+/* this part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE linux_driver_trace
+#include <trace/define_trace.h>
@@ -15,9 +15,30 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
 
 #include <linux/moduleparam.h>
+#include <linux/capability.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
+#include <linux/splice.h>
+#include <linux/io_uring/cmd.h>
+#include <linux/spinlock.h>
+#include <linux/list.h>
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jump_label.h>
+#include <linux/percpu-rwsem.h>
+#include <linux/rcupdate.h>
+#include <linux/hrtimer.h>
 #include <linux/module.h>
 #include <linux/device.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/log2.h>
+#include <linux/poll.h>
+#include <linux/mm.h>
+#include <linux/gfp.h>
+#include <linux/nodemask.h>
+#include <linux/topology.h>
 #include <linux/types.h>
 #include <linux/sched.h>
 #include <linux/ktime.h>
@@ -29,76 +50,205 @@
 
 #include "../include/linux_driver.h"
 
+#define CREATE_TRACE_POINTS
+#include "../include/linux_driver_trace.h"
+
 /* module info */
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Alexander (@alkuzin)");
 MODULE_DESCRIPTION("Character device driver for inter-process communication");
 
 /* define module ring buffer size param */
-static s32 buffer_size = 1024;
+static s32 buffer_size = 4096;
 /* S_IRUGO - read permissions for the owner, group, and others */
 module_param(buffer_size, int, S_IRUGO);
 MODULE_PARM_DESC(buffer_size, "Ring buffer size");
 
-/* blocking/non-blocking read/write mode flag */
-static int is_blocking = 1;
+/* define module number of channels param */
+static s32 num_channels = 1;
+module_param(num_channels, int, S_IRUGO);
+MODULE_PARM_DESC(num_channels, "Number of independent channels (device minors)");
+
+/* define module single-producer/single-consumer mode param */
+static bool spsc_mode = false;
+module_param(spsc_mode, bool, S_IRUGO);
+MODULE_PARM_DESC(spsc_mode, "Lock-free mode for one reader and one writer");
+
+/* define module latency histograms param */
+static bool latency_hist = false;
+module_param(latency_hist, bool, S_IRUGO);
+MODULE_PARM_DESC(latency_hist, "Collect wait time and queue residence latency histograms");
+
+/* define module overflow policy param */
+static bool overwrite = false;
+module_param(overwrite, bool, S_IRUGO);
+MODULE_PARM_DESC(overwrite, "Overwrite the oldest data instead of blocking writers on full ring buffer");
 
-static DECLARE_WAIT_QUEUE_HEAD(read_queue);
-static DECLARE_WAIT_QUEUE_HEAD(write_queue);
+/* define module ring buffer placement params */
+static s32 numa_node = NUMA_NO_NODE;
+module_param(numa_node, int, S_IRUGO);
+MODULE_PARM_DESC(numa_node, "NUMA node of ring buffers: -1 - node of insmod, -2 - node of the first reader");
+
+/* enabled if latency histograms are collected, so disabled ones cost nothing */
+static DEFINE_STATIC_KEY_FALSE(dev_hist_key);
+
+static dev_channel_t *channels = NULL;
 
-static char *device_buffer = NULL;
 static s32   major_number;
 static s32   minor_number;
 
 static struct class *dev_class;
-static struct cdev char_device;
-static struct device *device;
 static dev_t dev_number;
 
-static dev_buf_info_t buffer_info;
+/* debugfs directory with per-channel statistics & latency histograms */
+static struct dentry *debugfs_dir;
 
 /** @brief Set of operations that can be performed on a character device in the kernel. */
 static struct file_operations fops = {
     .owner          = THIS_MODULE,
     .open           = dev_open,
     .release        = dev_release,
-    .read           = dev_read,
-    .write          = dev_write,
+    .read_iter      = dev_read_iter,
+    .write_iter     = dev_write_iter,
+    /* splice()/sendfile()/tee() move data between the ring and pipe pages in kernel */
+    .splice_read    = copy_splice_read,
+    .splice_write   = iter_file_splice_write,
+    .poll           = dev_poll,
+    .mmap           = dev_mmap,
+#ifdef CONFIG_IO_URING
+    .uring_cmd      = dev_uring_cmd,
+#endif
     .unlocked_ioctl = dev_ioctl
 };
 
+/* channel statistics sysfs attributes: /sys/class/test_task_dev_class/test_task_dev<N>/statistics/ */
+DEV_STAT_ATTR(read_bytes);
+DEV_STAT_ATTR(write_bytes);
+DEV_STAT_ATTR(read_ops);
+DEV_STAT_ATTR(write_ops);
+DEV_STAT_ATTR(read_eagain);
+DEV_STAT_ATTR(write_eagain);
+DEV_STAT_ATTR(read_sleeps);
+DEV_STAT_ATTR(write_sleeps);
+DEV_STAT_ATTR(read_wakeups);
+DEV_STAT_ATTR(write_wakeups);
+DEV_STAT_ATTR(empty_events);
+DEV_STAT_ATTR(full_events);
+DEV_STAT_ATTR(max_used);
+DEV_STAT_ATTR(poll_hits);
+DEV_STAT_ATTR(poll_misses);
+DEV_STAT_ATTR(lost_bytes);
+DEV_STAT_ATTR(lost_msgs);
+static DEVICE_ATTR_RO(used);
+static DEVICE_ATTR_RW(size);
+static DEVICE_ATTR_RW(busy_poll);
+static DEVICE_ATTR_RW(numa_node);
+
+static struct attribute *dev_stats_attrs[] = {
+    &dev_attr_read_bytes.attr,
+    &dev_attr_write_bytes.attr,
+    &dev_attr_read_ops.attr,
+    &dev_attr_write_ops.attr,
+    &dev_attr_read_eagain.attr,
+    &dev_attr_write_eagain.attr,
+    &dev_attr_read_sleeps.attr,
+    &dev_attr_write_sleeps.attr,
+    &dev_attr_read_wakeups.attr,
+    &dev_attr_write_wakeups.attr,
+    &dev_attr_empty_events.attr,
+    &dev_attr_full_events.attr,
+    &dev_attr_max_used.attr,
+    &dev_attr_poll_hits.attr,
+    &dev_attr_poll_misses.attr,
+    &dev_attr_lost_bytes.attr,
+    &dev_attr_lost_msgs.attr,
+    &dev_attr_used.attr,
+    NULL
+};
+
+static const struct attribute_group dev_stats_group = {
+    .name  = "statistics",
+    .attrs = dev_stats_attrs
+};
+
+/* channel attributes: /sys/class/test_task_dev_class/test_task_dev<N>/ */
+static struct attribute *dev_attrs[] = {
+    &dev_attr_size.attr,
+    &dev_attr_busy_poll.attr,
+    &dev_attr_numa_node.attr,
+    NULL
+};
+
+static const struct attribute_group dev_attr_group = {
+    .attrs = dev_attrs
+};
+
+static const struct attribute_group *dev_groups[] = {
+    &dev_attr_group,
+    &dev_stats_group,
+    NULL
+};
+
+DEFINE_SHOW_ATTRIBUTE(dev_stats);
+
+/** @brief Latency histograms debugfs file operations (write resets histograms). */
+static const struct file_operations dev_hist_fops = {
+    .owner   = THIS_MODULE,
+    .open    = dev_hist_open,
+    .read    = seq_read,
+    .write   = dev_hist_write,
+    .llseek  = seq_lseek,
+    .release = single_release
+};
+
+/** @brief Ring buffer mapping operations, counting mappings that prevent resize. */
+static const struct vm_operations_struct dev_vm_ops = {
+    .open  = dev_vm_open,
+    .close = dev_vm_close
+};
 
 static s32 __init linux_driver_init(void)
 {
-    s32 ret;
+    struct dentry *dir;
+    s32 ret, i;
 
     printk(KERN_INFO DRIVER_NAME ": %s\n", "driver initialization");
-    printk(KERN_INFO DRIVER_NAME ": allocating %d bytes for ring buffer\n", buffer_size);
-    
-    device_buffer = kmalloc(buffer_size, GFP_KERNEL);
-    
-    if (!device_buffer) {
-        printk(KERN_ERR DRIVER_NAME ": %s\n", ": failed memory allocation: out of memory");
+
+    /* handle incorrect ring buffer size */
+    if (buffer_size <= 0 || buffer_size > RING_MAX_SIZE) {
+        printk(KERN_ERR DRIVER_NAME ": incorrect ring buffer size: %d\n", buffer_size);
+        return -EINVAL;
+    }
+
+    /* handle incorrect number of channels */
+    if (num_channels <= 0 || num_channels > MAX_CHANNELS) {
+        printk(KERN_ERR DRIVER_NAME ": incorrect number of channels: %d\n", num_channels);
+        return -EINVAL;
+    }
+
+    channels = kcalloc(num_channels, sizeof(dev_channel_t), GFP_KERNEL);
+
+    if (!channels) {
+        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed memory allocation: out of memory");
         return -ENOMEM;
     }
 
-    /* clear ring buffer */
-    memset(device_buffer, 0, buffer_size);
+    for (i = 0; i < num_channels; i++) {
+        ret = dev_channel_init(&channels[i], i);
 
-    /* clear device buffer info structure */
-    memset(&buffer_info, 0, sizeof(dev_buf_info_t));
+        if (ret < 0)
+            goto free_channels;
+    }
     
-    printk(KERN_INFO DRIVER_NAME ": %s\n", "successfully allocated ring buffer memory");
-
-    /* GFP_KERNEL means that allocation is performed on behalf of a process running in the kernel space */
+    printk(KERN_INFO DRIVER_NAME ": %s\n", "successfully allocated ring buffers memory");
     printk(KERN_INFO DRIVER_NAME ": %s\n", "character device initialization");
 
-    /* allocating major number */
-    ret = alloc_chrdev_region(&dev_number, 0, 1, DEVICE_NAME);
+    /* allocating major number & minor numbers for all channels */
+    ret = alloc_chrdev_region(&dev_number, 0, num_channels, DEVICE_NAME);
     
     if (ret < 0) {
         printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to allocate device number");
-        return ret;
+        goto free_channels;
     }
 
     major_number = MAJOR(dev_number);
@@ -106,216 +256,2500 @@ static s32 __init linux_driver_init(void)
 
     printk(KERN_INFO DRIVER_NAME ": set device number <major, minor>: <%d, %d>\n", major_number, minor_number);
 
-    /* initializing character device structure */
-    cdev_init(&char_device, &fops);
+    /* creating device class */
+    dev_class = class_create(DEVICE_CLASS);
 
-    /* adding character device to the system */
-    ret = cdev_add(&char_device, dev_number, 1);
-    
-    if (ret < 0) {
-        cdev_del(&char_device);
-        unregister_chrdev_region(dev_number, 1);
-        
-        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to add cdev");
-        return ret;
+    if (IS_ERR(dev_class)) {
+        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to create device class");
+        ret = PTR_ERR(dev_class);
+        goto unregister_region;
     }
 
-    /* creating device and device class */
-    dev_class = class_create(DEVICE_CLASS);
+    for (i = 0; i < num_channels; i++) {
+        /* initializing & adding character device of the channel to the system */
+        cdev_init(&channels[i].cdev, &fops);
+        channels[i].cdev.owner = THIS_MODULE;
 
-    if (!dev_class) {
-        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to create device class");
-        return -ENODEV;
+        ret = cdev_add(&channels[i].cdev, dev_number + i, 1);
+        
+        if (ret < 0) {
+            printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to add cdev");
+            goto destroy_devices;
+        }
+
+        channels[i].device = device_create_with_groups(dev_class, NULL, dev_number + i, &channels[i],
+                                                       dev_groups, DEVICE_NAME "%d", i);
+
+        if (IS_ERR(channels[i].device)) {
+            printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to create device");
+            ret = PTR_ERR(channels[i].device);
+            cdev_del(&channels[i].cdev);
+            goto destroy_devices;
+        }
     }
 
-    device = device_create(dev_class, NULL, dev_number, NULL, DEVICE_NAME);
+    /* debugfs is optional, errors are ignored */
+    debugfs_dir = debugfs_create_dir(DRIVER_NAME, NULL);
 
-    if (!device) {
-        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to create device");
-        return -ENODEV;
+    for (i = 0; i < num_channels; i++) {
+        dir = debugfs_create_dir(dev_name(channels[i].device), debugfs_dir);
+        debugfs_create_file("statistics", 0444, dir, &channels[i], &dev_stats_fops);
+        debugfs_create_file("latency", 0644, dir, &channels[i], &dev_hist_fops);
     }
 
+    if (latency_hist)
+        static_branch_enable(&dev_hist_key);
+
     printk(KERN_INFO DRIVER_NAME ": initialized character device class \"%s\"\n", DEVICE_CLASS);
-    printk(KERN_INFO DRIVER_NAME ": initialized character device \"%s\"\n", DEVICE_NAME);
+    printk(KERN_INFO DRIVER_NAME ": initialized %d character devices \"%s<N>\"\n", num_channels, DEVICE_NAME);
     return 0;
+
+destroy_devices:
+    while (--i >= 0) {
+        device_destroy(dev_class, dev_number + i);
+        cdev_del(&channels[i].cdev);
+    }
+
+    class_destroy(dev_class);
+
+unregister_region:
+    unregister_chrdev_region(dev_number, num_channels);
+
+free_channels:
+    for (i = 0; i < num_channels; i++)
+        dev_channel_free(&channels[i]);
+
+    kfree(channels);
+    return ret;
 }
 
 static void __exit linux_driver_exit(void)
 {
-    kfree(device_buffer);
-    printk(KERN_INFO DRIVER_NAME ": %s\n", "ring buffer memory freed successfully");
+    s32 i;
+
+    debugfs_remove_recursive(debugfs_dir);
+
+    for (i = 0; i < num_channels; i++) {
+        device_destroy(dev_class, dev_number + i);
+        cdev_del(&channels[i].cdev);
+    }
 
-    device_destroy(dev_class, dev_number);
     class_destroy(dev_class);
-    cdev_del(&char_device);
-    unregister_chrdev_region(dev_number, 1);
+    unregister_chrdev_region(dev_number, num_channels);
+
+    printk(KERN_INFO DRIVER_NAME ": %s\n", "unregistered character devices successfully");
 
-    printk(KERN_INFO DRIVER_NAME ": %s\n", "unregistered character device successfully");
+    for (i = 0; i < num_channels; i++)
+        dev_channel_free(&channels[i]);
+
+    kfree(channels);
+    printk(KERN_INFO DRIVER_NAME ": %s\n", "ring buffers memory freed successfully");
     printk(KERN_INFO DRIVER_NAME ": %s\n", "exit");
 }
 
-static s32 dev_open(struct inode *inode, struct file *file)
+static s32 dev_channel_init(dev_channel_t *ch, u32 index)
 {
-    printk(KERN_DEBUG DRIVER_NAME ": %s\n", "open character device");
+    ring_buffer_t *rb = &ch->ring;
+
+    u32 size, lane;
+    int node;
+
+    /* ring buffer indices are masked & data pages are mirrored, so size is a power of two pages */
+    size = max_t(u32, roundup_pow_of_two(buffer_size), PAGE_SIZE);
+
+    /* until the first reader opens the channel, ring buffer is local to insmod */
+    ch->node = numa_node;
+    node     = NUMA_NO_NODE;
+
+    if (numa_node >= 0 && numa_node < MAX_NUMNODES && node_online(numa_node))
+        node = numa_node;
+    else if (numa_node != RING_NODE_READER)
+        ch->node = NUMA_NO_NODE;
+
+    printk(KERN_INFO DRIVER_NAME ": allocating %u bytes for ring buffer of channel %u\n", size, index);
+    
+    if (ring_alloc(rb, size, node)) {
+        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed memory allocation: out of memory");
+        return -ENOMEM;
+    }
+
+    /* per-CPU counters, so data path never shares cache lines for statistics */
+    ch->stats = alloc_percpu(dev_stats_t);
+    ch->hist  = alloc_percpu(dev_hist_t);
+
+    if (!ch->stats || !ch->hist || percpu_init_rwsem(&ch->resize_sem)) {
+        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed memory allocation: out of memory");
+        return -ENOMEM;
+    }
+
+    mutex_init(&ch->read_lock);
+    mutex_init(&ch->write_lock);
+    init_waitqueue_head(&ch->read_queue);
+    init_waitqueue_head(&ch->write_queue);
+    spin_lock_init(&ch->uring_lock);
+    INIT_LIST_HEAD(&ch->uring_readers);
+    INIT_LIST_HEAD(&ch->uring_writers);
+    INIT_LIST_HEAD(&ch->uring_lockers);
+    spin_lock_init(&ch->bcast_lock);
+    INIT_LIST_HEAD(&ch->bcast_readers);
+    spin_lock_init(&ch->reserve_lock);
+
+    /* lane ring buffers are allocated by IOCTL_LANES */
+    for (lane = 1; lane < LANES_MAX; lane++)
+        mutex_init(&ch->prio[lane - 1].write_lock);
+
+    ch->lanes = 1;
+    hrtimer_setup(&ch->flush_timer, dev_flush_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+    atomic_set(&ch->held_msgs, 0);
+    ch->overwrite = overwrite;
+    atomic64_set(&ch->gap, 0);
+
+    ch->index = index;
     return 0;
 }
 
-static s32 dev_release(struct inode *inode, struct file *file)
+static void dev_channel_free(dev_channel_t *ch)
 {
-    printk(KERN_DEBUG DRIVER_NAME ": %s\n", "release character device");
-    return 0;
+    u32 lane;
+
+    /* timer is set up with the rest of the channel, hrtimer_setup() sets its function */
+    if (ch->flush_timer.function)
+        hrtimer_cancel(&ch->flush_timer);
+
+    /* ring_destroy(), free_percpu() & percpu_free_rwsem() handle not allocated memory */
+    ring_destroy(&ch->ring);
+
+    for (lane = 1; lane < LANES_MAX; lane++)
+        ring_destroy(&ch->prio[lane - 1].ring);
+
+    free_percpu(ch->stats);
+    free_percpu(ch->hist);
+    percpu_free_rwsem(&ch->resize_sem);
+
+    ch->ring.ctrl = NULL;
+    ch->stats     = NULL;
+    ch->hist      = NULL;
 }
 
-static ssize_t dev_read(struct file *file, char *buffer, size_t length, loff_t *offset)
+static void dev_ring_drop(dev_channel_t *ch, u32 need, bool msg_mode)
 {
-    char    date_buf[64];
-    ssize_t bytes_read;
-    ktime_t cur_time;
-    struct  tm tm;
-    s32     ret;
-    
-    printk(KERN_DEBUG DRIVER_NAME ": %s\n", "read character device");
+    u32 bytes, msgs;
 
-    /* handle blocking/non-blocking mode of read operation */
-    if (is_blocking)
-        wait_event_interruptible(read_queue, device_buffer[0] != '\0');
-    else {
-        /* handle empty device buffer */
-        if (device_buffer[0] == '\0')
-            return -EAGAIN;
+    bytes = ring_drop(&ch->ring, need, msg_mode, &msgs);
+
+    if (!bytes)
+        return;
+
+    this_cpu_add(ch->stats->lost_bytes, bytes);
+    this_cpu_add(ch->stats->lost_msgs, msgs);
+    atomic64_add(bytes, &ch->gap);
+}
+
+static u32 dev_ring_used(dev_channel_t *ch)
+{
+    u32 used;
+
+    /* ring buffer memory is freed by resize only after RCU grace period */
+    rcu_read_lock();
+    used = dev_lanes_used(ch, 0);
+    rcu_read_unlock();
+
+    return used;
+}
+
+static u32 dev_ring_free(dev_channel_t *ch)
+{
+    u32 avail;
+
+    rcu_read_lock();
+
+    /* multi-producer writers need space not reserved by other writers yet */
+    if (READ_ONCE(ch->mp_mode))
+        avail = READ_ONCE(ch->ring.size) - (READ_ONCE(ch->reserve) - smp_load_acquire(&ch->ring.ctrl->tail));
+    else
+        avail = ring_free(&ch->ring);
+
+    rcu_read_unlock();
+
+    return avail;
+}
+
+static inline ring_buffer_t *dev_lane_ring(dev_channel_t *ch, u32 lane)
+{
+    return lane ? &ch->prio[lane - 1].ring : &ch->ring;
+}
+
+static inline struct mutex *dev_lane_lock(dev_channel_t *ch, u32 lane)
+{
+    return lane ? &ch->prio[lane - 1].write_lock : &ch->write_lock;
+}
+
+static inline u32 dev_file_lane(dev_channel_t *ch, dev_file_t *df)
+{
+    /* lane of the file may be out of the current number of lanes */
+    return df ? umin(READ_ONCE(df->lane), smp_load_acquire(&ch->lanes) - 1) : 0;
+}
+
+static u32 dev_lanes_used(dev_channel_t *ch, u32 first)
+{
+    u32 lane, used = 0;
+
+    /* pairs with smp_store_release() in dev_lanes_set(): lane ring buffers are allocated */
+    for (lane = first; lane < smp_load_acquire(&ch->lanes); lane++)
+        used += ring_used(dev_lane_ring(ch, lane));
+
+    return used;
+}
+
+static u32 dev_lane_free(dev_channel_t *ch, u32 lane)
+{
+    u32 avail = 0;
+
+    if (!lane)
+        return dev_ring_free(ch);
+
+    /* lane ring buffers are freed by dev_lanes_set() only after RCU grace period */
+    rcu_read_lock();
+
+    if (lane < smp_load_acquire(&ch->lanes))
+        avail = ring_free(dev_lane_ring(ch, lane));
+
+    rcu_read_unlock();
+
+    return avail;
+}
+
+static u32 dev_lane_pick(dev_channel_t *ch)
+{
+    u32 lane, lower, i;
+
+    for (lane = ch->lanes - 1; lane && !ring_used(dev_lane_ring(ch, lane)); lane--)
+        ;
+
+    /* lane used up its weight, lower lane with data gets one read */
+    if (lane && ch->lane_weight[lane] && ch->lane_served[lane] >= ch->lane_weight[lane]) {
+        for (lower = lane - 1; lower && !ring_used(dev_lane_ring(ch, lower)); lower--)
+            ;
+
+        if (ring_used(dev_lane_ring(ch, lower)))
+            lane = lower;
     }
-    
-    /* handle the end of the file */
-    if (*offset >= buffer_size)
-        return 0; 
 
-    bytes_read = umin(length, buffer_size - *offset);
-    ret        = copy_to_user(buffer, device_buffer + *offset, bytes_read);
+    /* only consecutive reads of a lane are counted against its weight */
+    for (i = 0; i < LANES_MAX; i++) {
+        if (i != lane)
+            ch->lane_served[i] = 0;
+    }
 
-    if (ret) {
-        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to copy data to user space");
-        return -EFAULT;
+    ch->lane_served[lane]++;
+    ch->lane_reads[lane]++;
+    return lane;
+}
+
+static s32 dev_ring_resize(dev_channel_t *ch, unsigned long size, int node)
+{
+    ring_buffer_t *rb = &ch->ring;
+    ring_buffer_t new, old;
+    u32 used, tail;
+    bool resized = false;
+    s32 ret = 0;
+
+    if (!size || size > RING_MAX_SIZE)
+        return -EINVAL;
+
+    /* allocation may take long for large ring buffers, so data path is not stopped for it */
+    if (ring_alloc(&new, max_t(u32, roundup_pow_of_two(size), PAGE_SIZE), node))
+        return -ENOMEM;
+
+    /* waits for readers & writers currently accessing the ring buffer */
+    percpu_down_write(&ch->resize_sem);
+
+    /* user space mappings & kernel users can not be moved to the new ring buffer, lanes keep their size */
+    if (atomic_read(&ch->mmaps) || atomic_read(&ch->kusers) || ch->lanes > 1) {
+        ret = -EBUSY;
+        goto unlock;
     }
 
-    *offset += bytes_read;
-    
-    /* clear ring buffer */
-    memset(device_buffer, 0, bytes_read);
+    used = ring_used(rb);
 
-    cur_time = ktime_get_real_seconds();
+    /* queued data must fit into the new ring buffer */
+    if (used > new.size) {
+        ret = -EBUSY;
+        goto unlock;
+    }
 
-    buffer_info.last_read_time  = cur_time;
-    buffer_info.last_read_pid   = current->pid;
-    buffer_info.last_read_owner = current_uid().val;
-    
-    /* display last read time, PID & UID */
-    time64_to_tm(cur_time, 0, &tm);
-    snprintf(date_buf, sizeof(date_buf), DATE_FORMAT, tm.tm_mon + 1, tm.tm_mday, 
-             tm.tm_year + 1900, tm.tm_hour + UTC_OFFSET, tm.tm_min, tm.tm_sec);
-
-    printk(KERN_DEBUG DRIVER_NAME ": dev_read: [%s]\n", date_buf);
-    printk(KERN_DEBUG DRIVER_NAME ": dev_read: PID: %d\n", buffer_info.last_write_pid);
-    printk(KERN_DEBUG DRIVER_NAME ": dev_read: UID: %d\n", buffer_info.last_write_owner);
-    
-    return bytes_read;
+    if (new.size == rb->size && new.node == rb->node)
+        goto unlock;
+
+    /* indices are preserved, so positions remembered by readers stay valid */
+    tail = rb->ctrl->tail;
+
+    new.ctrl->head = tail + used;
+    new.ctrl->tail = tail;
+
+    /* waiters counters are updated only under resize_sem (see dev_wait_readable()) */
+    atomic_set(&new.ctrl->read_waiters, atomic_read(&rb->ctrl->read_waiters));
+    atomic_set(&new.ctrl->write_waiters, atomic_read(&rb->ctrl->write_waiters));
+
+    /* queued data is contiguous in the mirrored mapping */
+    ring_put(&new, tail, rb->data + (tail & (rb->size - 1)), used);
+
+    old = *rb;
+
+    /* lockless observers may see old & new fields mixed, which only affects their result */
+    WRITE_ONCE(rb->ctrl, new.ctrl);
+    WRITE_ONCE(rb->data, new.data);
+    WRITE_ONCE(rb->pages, new.pages);
+    WRITE_ONCE(rb->size, new.size);
+    WRITE_ONCE(rb->node, new.node);
+
+    /* multi-producer writers reserve & commit only under resize_sem, so nothing is in flight */
+    WRITE_ONCE(ch->reserve, tail + used);
+
+    new     = old;
+    resized = true;
+
+unlock:
+    dev_resize_unlock(ch);
+
+    if (resized) {
+        printk(KERN_INFO DRIVER_NAME ": reallocated ring buffer of channel %u: %u bytes, node %d\n",
+               ch->index, rb->size, rb->node);
+
+        /* waiters re-check their conditions against the new size */
+        dev_wake_readers(ch);
+        dev_wake_writers(ch);
+        synchronize_rcu();
+    }
+
+    ring_destroy(&new);
+    return ret;
 }
 
-static ssize_t dev_write(struct file *file, const char *buffer, size_t length, loff_t *offset)
+static s32 dev_ring_place(dev_channel_t *ch, long node)
 {
-    ktime_t cur_time;
-    char    date_buf[64];
-    struct  tm tm;
-    s32     ret;
+    if (node != NUMA_NO_NODE && node != RING_NODE_READER && (node < 0 || node >= MAX_NUMNODES || !node_online(node)))
+        return -EINVAL;
 
-    printk(KERN_DEBUG DRIVER_NAME ": %s\n", "write to character device");
+    WRITE_ONCE(ch->node, node);
 
-    /* handle blocking/non-blocking mode of read operation */
-    if (is_blocking)
-        wait_event_interruptible(write_queue, device_buffer[0] == '\0');
-    else {
-        /* handle filled device buffer */
-        if (device_buffer[0] != '\0')
-            return -EAGAIN;
+    /* node of the reader is known only at its open */
+    if (node == RING_NODE_READER) {
+        WRITE_ONCE(ch->placed, 0);
+        return 0;
     }
 
-    /* handle incorrect argument */
-    if (length > buffer_size)
-        return -EINVAL;
-    
-    /* handle the end of the file */
-    if (*offset >= buffer_size)
-        return 0; 
-    
-    /* null-terminate the device buffer to treat it as a string */
-    device_buffer[length] = '\0';
+    return dev_ring_resize(ch, READ_ONCE(ch->ring.size), node);
+}
 
-    ret = copy_from_user(device_buffer, buffer, length);
+static s32 dev_lock_side(dev_channel_t *ch, struct mutex *lock, bool nowait)
+{
+    if (!spsc_mode && lock) {
+        /* do not sleep on lock held by a blocked reader/writer */
+        if (nowait && !mutex_trylock(lock))
+            return -EAGAIN;
 
-    if (ret) {
-        printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to copy data from user space");
-        return -EFAULT;
+        if (!nowait && mutex_lock_interruptible(lock))
+            return -ERESTARTSYS;
     }
 
-    wake_up_interruptible(&read_queue);
-    
-    cur_time = ktime_get_real_seconds();
-    
-    buffer_info.last_write_owner = current_uid().val;
-    buffer_info.last_write_pid   = current->pid;
-    buffer_info.last_write_time  = cur_time;
-    
-    /* display last write time, PID & UID */
-    time64_to_tm(cur_time, 0, &tm);
-    snprintf(date_buf, sizeof(date_buf), DATE_FORMAT, tm.tm_mon + 1, tm.tm_mday, 
-             tm.tm_year + 1900, tm.tm_hour + UTC_OFFSET, tm.tm_min, tm.tm_sec);
+    /* ring buffer is not resized while the side accesses it */
+    if (!nowait)
+        percpu_down_read(&ch->resize_sem);
+    else if (!percpu_down_read_trylock(&ch->resize_sem)) {
+        if (!spsc_mode && lock) {
+            mutex_unlock(lock);
+            dev_uring_kick(ch, &ch->uring_lockers);
+        }
 
-    printk(KERN_DEBUG DRIVER_NAME ": dev_write: [%s]\n", date_buf);
-    printk(KERN_DEBUG DRIVER_NAME ": dev_write: PID: %d\n", buffer_info.last_write_pid);
-    printk(KERN_DEBUG DRIVER_NAME ": dev_write: UID: %d\n", buffer_info.last_write_owner);
+        return -EAGAIN;
+    }
 
-    return length;
+    return 0;
 }
 
-static long dev_ioctl(struct file *file, u32 cmd, unsigned long arg)
+static void dev_unlock_side(dev_channel_t *ch, struct mutex *lock)
+{
+    percpu_up_read(&ch->resize_sem);
+
+    if (!spsc_mode && lock)
+        mutex_unlock(lock);
+
+    dev_uring_kick(ch, &ch->uring_lockers);
+}
+
+static void dev_resize_unlock(dev_channel_t *ch)
+{
+    percpu_up_write(&ch->resize_sem);
+    dev_uring_kick(ch, &ch->uring_lockers);
+}
+
+static s32 dev_lock_writer(dev_channel_t *ch, dev_file_t *df, bool nowait, struct mutex **lock, u32 *lane)
 {
-    dev_buf_info_t info;
     s32 ret;
-    
-    switch (cmd) {
-        case IOCTL_BLOCK:
-            printk(KERN_INFO DRIVER_NAME ": %s\n", "IOCTL_BLOCK");
-            is_blocking = 1;
-            printk(KERN_INFO DRIVER_NAME ": %s\n", "blocking mode was enabled");
-            break;
-        
-        case IOCTL_NONBLOCK:
-            printk(KERN_INFO DRIVER_NAME ": %s\n", "IOCTL_NONBLOCK");
-            is_blocking = 0;
-            printk(KERN_INFO DRIVER_NAME ": %s\n", "blocking mode was disabled");
-            break;
-        
-        case IOCTL_BUFINFO:
-            printk(KERN_INFO DRIVER_NAME ": %s\n", "IOCTL_BUFINFO");
-            
-            info = buffer_info;
-            ret  = copy_to_user((dev_buf_info_t *)arg, &info, sizeof(dev_buf_info_t));
-
-            if (ret) {
-                printk(KERN_ERR DRIVER_NAME ": %s\n", "failed to copy buffer info to user space");
-                return -EFAULT;
-            }
-            
-            printk(KERN_INFO DRIVER_NAME ": %s\n", "buffer info was sent");
-            break;
-    
-        default:
-            printk(KERN_ERR DRIVER_NAME ": %s\n", "incorrect IOCTL command");
-            return -EINVAL;
+
+retry:
+    /* multi-producer writers are serialized only by slot reservation */
+    *lane = dev_file_lane(ch, df);
+    *lock = READ_ONCE(ch->mp_mode) ? NULL : dev_lane_lock(ch, *lane);
+    ret   = dev_lock_side(ch, *lock, nowait);
+
+    if (ret)
+        return ret;
+
+    /* mode or lanes changed before resize_sem was taken */
+    if ((!*lock && !READ_ONCE(ch->mp_mode)) || *lane != dev_file_lane(ch, df)) {
+        dev_unlock_side(ch, *lock);
+        goto retry;
     }
 
     return 0;
 }
 
+static inline bool dev_wait_ready(dev_channel_t *ch, dev_file_t *df, u32 lane, bool write, u32 count)
+{
+    /* count is limited by current size, as ring buffer may be shrunk while waiting */
+    count = umin(count, READ_ONCE(ch->ring.size));
+
+    if (write)
+        return dev_lane_free(ch, lane) >= count;
+
+    /* broadcast reader has its own cursor */
+    return (df ? dev_bcast_used(df) : dev_ring_used(ch)) >= count;
+}
+
+static bool dev_busy_poll(dev_channel_t *ch, dev_file_t *df, u32 lane, u32 *budget, bool write, u32 count)
+{
+    u32 limit = READ_ONCE(*budget);
+    u64 start;
+
+    if (!limit)
+        return false;
+
+    start = ktime_get_ns();
+
+    do {
+        if (dev_wait_ready(ch, df, lane, write, count)) {
+            this_cpu_inc(ch->stats->poll_hits);
+            return true;
+        }
+
+        cpu_relax();
+    } while (!need_resched() && !signal_pending(current) && ktime_get_ns() - start < limit);
+
+    this_cpu_inc(ch->stats->poll_misses);
+    return false;
+}
+
+static void dev_busy_poll_adapt(dev_channel_t *ch, u32 *budget, u64 slept)
+{
+    u32 max = READ_ONCE(ch->busy_poll) * NSEC_PER_USEC;
+
+    if (!max)
+        return;
+
+    /* spinning a bit longer would have avoided the sleep, otherwise spinning is wasted */
+    if (slept < max)
+        WRITE_ONCE(*budget, umin(max, 2 * slept));
+    else
+        WRITE_ONCE(*budget, READ_ONCE(*budget) / 2);
+}
+
+static s32 dev_busy_poll_set(dev_channel_t *ch, unsigned long usecs)
+{
+    if (usecs > BUSY_POLL_MAX)
+        return -EINVAL;
+
+    WRITE_ONCE(ch->busy_poll, usecs);
+
+    /* adaptation starts from the full budget */
+    WRITE_ONCE(ch->read_poll_ns, usecs * NSEC_PER_USEC);
+    WRITE_ONCE(ch->write_poll_ns, usecs * NSEC_PER_USEC);
+    return 0;
+}
+
+static s32 dev_wait_readable(dev_channel_t *ch, dev_file_t *df, u32 count, long *timeout)
+{
+    u64  start = 0, duration;
+    long ret;
+
+    /* spin for data arriving soon instead of sleep & wake up round trip */
+    if (dev_busy_poll(ch, df, 0, &ch->read_poll_ns, false, count))
+        return 0;
+
+    /* clock is read only while tracepoint, histograms or busy-poll are enabled */
+    if (trace_ldrv_wait_enabled() || static_branch_unlikely(&dev_hist_key) || READ_ONCE(ch->busy_poll))
+        start = ktime_get_ns();
+
+    /* let user space writer know that it has to issue IOCTL_WAKE */
+    percpu_down_read(&ch->resize_sem);
+    atomic_inc(&ch->ring.ctrl->read_waiters);
+    smp_mb__after_atomic();
+    percpu_up_read(&ch->resize_sem);
+    this_cpu_inc(ch->stats->read_sleeps);
+
+    ret = wait_event_interruptible_timeout(ch->read_queue, dev_wait_ready(ch, df, 0, false, count), *timeout);
+
+    percpu_down_read(&ch->resize_sem);
+    atomic_dec(&ch->ring.ctrl->read_waiters);
+    percpu_up_read(&ch->resize_sem);
+
+    /* remaining time is left for the next wait of the same call */
+    if (ret > 0) {
+        *timeout = ret;
+        ret = 0;
+    }
+    else
+        ret = ret ? -ERESTARTSYS : -ETIMEDOUT;
+
+    if (start) {
+        duration = ktime_get_ns() - start;
+        dev_hist_record(ch, LAT_READ_WAIT, duration);
+        dev_busy_poll_adapt(ch, &ch->read_poll_ns, duration);
+        trace_ldrv_wait(ch->index, false, count, duration, ret);
+    }
+
+    return ret;
+}
+
+static s32 dev_wait_writable(dev_channel_t *ch, u32 lane, u32 count, long *timeout)
+{
+    u64  start = 0, duration;
+    long ret;
+
+    /* spin for space arriving soon instead of sleep & wake up round trip */
+    if (dev_busy_poll(ch, NULL, lane, &ch->write_poll_ns, true, count))
+        return 0;
+
+    /* clock is read only while tracepoint, histograms or busy-poll are enabled */
+    if (trace_ldrv_wait_enabled() || static_branch_unlikely(&dev_hist_key) || READ_ONCE(ch->busy_poll))
+        start = ktime_get_ns();
+
+    /* let user space reader know that it has to issue IOCTL_WAKE */
+    percpu_down_read(&ch->resize_sem);
+    atomic_inc(&ch->ring.ctrl->write_waiters);
+    smp_mb__after_atomic();
+    percpu_up_read(&ch->resize_sem);
+    this_cpu_inc(ch->stats->write_sleeps);
+
+    ret = wait_event_interruptible_timeout(ch->write_queue, dev_wait_ready(ch, NULL, lane, true, count), *timeout);
+
+    percpu_down_read(&ch->resize_sem);
+    atomic_dec(&ch->ring.ctrl->write_waiters);
+    percpu_up_read(&ch->resize_sem);
+
+    /* remaining time is left for the next wait of the same call */
+    if (ret > 0) {
+        *timeout = ret;
+        ret = 0;
+    }
+    else
+        ret = ret ? -ERESTARTSYS : -ETIMEDOUT;
+
+    if (start) {
+        duration = ktime_get_ns() - start;
+        dev_hist_record(ch, LAT_WRITE_WAIT, duration);
+        dev_busy_poll_adapt(ch, &ch->write_poll_ns, duration);
+        trace_ldrv_wait(ch->index, true, count, duration, ret);
+    }
+
+    return ret;
+}
+
+static inline bool dev_wake_up(struct wait_queue_head *queue, __poll_t mask)
+{
+    /* wq_has_sleeper() contains barrier pairing with the waiter */
+    if (!wq_has_sleeper(queue))
+        return false;
+
+    wake_up_interruptible_poll(queue, mask);
+    return true;
+}
+
+static void dev_wake_readers(dev_channel_t *ch)
+{
+    /* message watermark counts from the last wake up */
+    if (atomic_read(&ch->held_msgs))
+        atomic_set(&ch->held_msgs, 0);
+
+    if (dev_wake_up(&ch->read_queue, EPOLLIN | EPOLLRDNORM)) {
+        this_cpu_inc(ch->stats->read_wakeups);
+        trace_ldrv_wake(ch->index, false);
+    }
+
+    dev_uring_kick(ch, &ch->uring_readers);
+}
+
+static void dev_wake_writers(dev_channel_t *ch)
+{
+    if (dev_wake_up(&ch->write_queue, EPOLLOUT | EPOLLWRNORM)) {
+        this_cpu_inc(ch->stats->write_wakeups);
+        trace_ldrv_wake(ch->index, true);
+    }
+
+    dev_uring_kick(ch, &ch->uring_writers);
+}
+
+static void dev_notify_readers(dev_channel_t *ch)
+{
+    u32  lowat = READ_ONCE(ch->read_lowat);
+    u32  lowat_msgs = READ_ONCE(ch->read_lowat_msgs);
+    bool bytes, msgs;
+    u32  delay;
+
+    bytes = lowat > 1;
+    msgs  = lowat_msgs > 1 && READ_ONCE(ch->msg_mode);
+
+    /* readers are woken once enough data or messages are queued or flush deadline expires */
+    if ((bytes || msgs) && (!bytes || dev_ring_used(ch) < umin(lowat, READ_ONCE(ch->ring.size))) &&
+        (!msgs || atomic_read(&ch->held_msgs) < lowat_msgs)) {
+        delay = READ_ONCE(ch->flush_delay);
+
+        if (delay && !hrtimer_is_queued(&ch->flush_timer))
+            hrtimer_start(&ch->flush_timer, us_to_ktime(delay), HRTIMER_MODE_REL_SOFT);
+
+        return;
+    }
+
+    hrtimer_try_to_cancel(&ch->flush_timer);
+    dev_wake_readers(ch);
+}
+
+static void dev_notify_writers(dev_channel_t *ch)
+{
+    u32 lowat = READ_ONCE(ch->write_lowat);
+
+    /* writers are woken once enough space is free, with lanes any lane may have freed it */
+    if (lowat > 1 && READ_ONCE(ch->lanes) == 1 && dev_ring_free(ch) < umin(lowat, READ_ONCE(ch->ring.size)))
+        return;
+
+    dev_wake_writers(ch);
+}
+
+static void dev_flush(dev_channel_t *ch)
+{
+    hrtimer_try_to_cancel(&ch->flush_timer);
+
+    if (dev_ring_used(ch))
+        dev_wake_readers(ch);
+}
+
+static enum hrtimer_restart dev_flush_timer(struct hrtimer *timer)
+{
+    dev_channel_t *ch = container_of(timer, dev_channel_t, flush_timer);
+
+    dev_wake_readers(ch);
+    return HRTIMER_NORESTART;
+}
+
+static long dev_lowat_set(dev_channel_t *ch, dev_lowat_t __user *arg)
+{
+    dev_lowat_t lowat;
+
+    if (copy_from_user(&lowat, arg, sizeof(dev_lowat_t)))
+        return -EFAULT;
+
+    if (lowat.read_lowat > RING_MAX_SIZE || lowat.write_lowat > RING_MAX_SIZE ||
+        lowat.read_lowat_msgs > RING_MAX_SIZE || lowat.flush_delay > FLUSH_DELAY_MAX)
+        return -EINVAL;
+
+    WRITE_ONCE(ch->read_lowat, lowat.read_lowat);
+    WRITE_ONCE(ch->read_lowat_msgs, lowat.read_lowat_msgs);
+    WRITE_ONCE(ch->write_lowat, lowat.write_lowat);
+    WRITE_ONCE(ch->flush_delay, lowat.flush_delay);
+
+    /* data already held back is released with the old settings */
+    dev_flush(ch);
+    dev_wake_writers(ch);
+    return 0;
+}
+
+static inline void dev_op_info_update(dev_op_info_t *info)
+{
+    /* raw seconds only, formatting is left to user space */
+    info->time  = ktime_get_real_seconds();
+    info->pid   = current->pid;
+    info->owner = current_uid().val;
+}
+
+static void dev_stats_sum(dev_channel_t *ch, dev_stats_t *sum)
+{
+    dev_stats_t *stats;
+    s32 cpu;
+
+    memset(sum, 0, sizeof(dev_stats_t));
+
+    for_each_possible_cpu(cpu) {
+        stats = per_cpu_ptr(ch->stats, cpu);
+
+        sum->read_bytes    += READ_ONCE(stats->read_bytes);
+        sum->write_bytes   += READ_ONCE(stats->write_bytes);
+        sum->read_ops      += READ_ONCE(stats->read_ops);
+        sum->write_ops     += READ_ONCE(stats->write_ops);
+        sum->read_eagain   += READ_ONCE(stats->read_eagain);
+        sum->write_eagain  += READ_ONCE(stats->write_eagain);
+        sum->read_sleeps   += READ_ONCE(stats->read_sleeps);
+        sum->write_sleeps  += READ_ONCE(stats->write_sleeps);
+        sum->read_wakeups  += READ_ONCE(stats->read_wakeups);
+        sum->write_wakeups += READ_ONCE(stats->write_wakeups);
+        sum->empty_events  += READ_ONCE(stats->empty_events);
+        sum->full_events   += READ_ONCE(stats->full_events);
+        sum->poll_hits     += READ_ONCE(stats->poll_hits);
+        sum->poll_misses   += READ_ONCE(stats->poll_misses);
+        sum->lost_bytes    += READ_ONCE(stats->lost_bytes);
+        sum->lost_msgs     += READ_ONCE(stats->lost_msgs);
+        sum->max_used       = max(sum->max_used, READ_ONCE(stats->max_used));
+    }
+}
+
+static ssize_t used_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    dev_channel_t *ch = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", dev_ring_used(ch));
+}
+
+static ssize_t size_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    dev_channel_t *ch = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(ch->ring.size));
+}
+
+static ssize_t busy_poll_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    dev_channel_t *ch = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%u\n", READ_ONCE(ch->busy_poll));
+}
+
+static ssize_t busy_poll_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    unsigned long usecs;
+    s32 ret;
+
+    ret = kstrtoul(buf, 0, &usecs);
+
+    if (ret)
+        return ret;
+
+    ret = dev_busy_poll_set(dev_get_drvdata(dev), usecs);
+
+    return ret ? ret : count;
+}
+
+static ssize_t size_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    dev_channel_t *ch;
+    unsigned long size;
+    s32 ret;
+
+    ret = kstrtoul(buf, 0, &size);
+
+    if (ret)
+        return ret;
+
+    ch  = dev_get_drvdata(dev);
+    ret = dev_ring_resize(ch, size, READ_ONCE(ch->ring.node));
+
+    return ret ? ret : count;
+}
+
+static ssize_t numa_node_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+    dev_channel_t *ch = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%d\n", READ_ONCE(ch->node));
+}
+
+static ssize_t numa_node_store(struct device *dev, struct device_attribute *attr, const char *buf, size_t count)
+{
+    long node;
+    s32  ret;
+
+    ret = kstrtol(buf, 0, &node);
+
+    if (ret)
+        return ret;
+
+    ret = dev_ring_place(dev_get_drvdata(dev), node);
+
+    return ret ? ret : count;
+}
+
+static s32 dev_stats_show(struct seq_file *s, void *unused)
+{
+    dev_channel_t *ch = s->private;
+    dev_stats_t   stats;
+    u32 lane, lanes;
+
+    dev_stats_sum(ch, &stats);
+
+    seq_printf(s, "size:          %u\n",   READ_ONCE(ch->ring.size));
+
+    /* resize frees ring buffer pages only after RCU grace period */
+    rcu_read_lock();
+    seq_printf(s, "node:          %d\n",   page_to_nid(READ_ONCE(ch->ring.pages)[0]));
+    rcu_read_unlock();
+
+    seq_printf(s, "used:          %u\n",   dev_ring_used(ch));
+    seq_printf(s, "max_used:      %llu\n", stats.max_used);
+    seq_printf(s, "read_bytes:    %llu\n", stats.read_bytes);
+    seq_printf(s, "write_bytes:   %llu\n", stats.write_bytes);
+    seq_printf(s, "read_ops:      %llu\n", stats.read_ops);
+    seq_printf(s, "write_ops:     %llu\n", stats.write_ops);
+    seq_printf(s, "read_eagain:   %llu\n", stats.read_eagain);
+    seq_printf(s, "write_eagain:  %llu\n", stats.write_eagain);
+    seq_printf(s, "read_sleeps:   %llu\n", stats.read_sleeps);
+    seq_printf(s, "write_sleeps:  %llu\n", stats.write_sleeps);
+    seq_printf(s, "read_wakeups:  %llu\n", stats.read_wakeups);
+    seq_printf(s, "write_wakeups: %llu\n", stats.write_wakeups);
+    seq_printf(s, "empty_events:  %llu\n", stats.empty_events);
+    seq_printf(s, "full_events:   %llu\n", stats.full_events);
+    seq_printf(s, "poll_hits:     %llu\n", stats.poll_hits);
+    seq_printf(s, "poll_misses:   %llu\n", stats.poll_misses);
+    seq_printf(s, "lost_bytes:    %llu\n", stats.lost_bytes);
+    seq_printf(s, "lost_msgs:     %llu\n", stats.lost_msgs);
+
+    /* lane ring buffers are freed only after RCU grace period */
+    rcu_read_lock();
+    lanes = smp_load_acquire(&ch->lanes);
+
+    for (lane = 0; lanes > 1 && lane < lanes; lane++)
+        seq_printf(s, "lane%u:         used %u reads %llu writes %llu\n", lane,
+                   ring_used(dev_lane_ring(ch, lane)), READ_ONCE(ch->lane_reads[lane]), READ_ONCE(ch->lane_writes[lane]));
+
+    rcu_read_unlock();
+    return 0;
+}
+
+static inline u32 dev_hist_bucket(u64 value)
+{
+    u32 exp, bucket;
+
+    /* small values have their own buckets */
+    if (value < LAT_SUB_BUCKETS)
+        return value;
+
+    /* power of two range split into LAT_SUB_BUCKETS linear sub-buckets */
+    exp    = fls64(value) - 1;
+    bucket = ((exp - LAT_SUB_BITS + 1) << LAT_SUB_BITS) +
+             ((value >> (exp - LAT_SUB_BITS)) & (LAT_SUB_BUCKETS - 1));
+
+    return umin(bucket, LAT_BUCKETS - 1);
+}
+
+static u64 dev_hist_lower(u32 bucket)
+{
+    u32 group = bucket >> LAT_SUB_BITS;
+
+    if (!group)
+        return bucket;
+
+    return (u64)(LAT_SUB_BUCKETS + (bucket & (LAT_SUB_BUCKETS - 1))) << (group - 1);
+}
+
+static inline void dev_hist_record(dev_channel_t *ch, u32 type, u64 value)
+{
+    if (static_branch_unlikely(&dev_hist_key))
+        this_cpu_inc(ch->hist->counts[type][dev_hist_bucket(value)]);
+}
+
+static void dev_hist_sum(dev_channel_t *ch, u32 type, u64 *counts)
+{
+    dev_hist_t *hist;
+    s32 cpu, i;
+
+    memset(counts, 0, sizeof(u64) * LAT_BUCKETS);
+
+    for_each_possible_cpu(cpu) {
+        hist = per_cpu_ptr(ch->hist, cpu);
+
+        for (i = 0; i < LAT_BUCKETS; i++)
+            counts[i] += READ_ONCE(hist->counts[type][i]);
+    }
+}
+
+static void dev_hist_reset(dev_channel_t *ch)
+{
+    s32 cpu;
+
+    /* concurrent updates may survive the reset, which is fine for statistics */
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(ch->hist, cpu), 0, sizeof(dev_hist_t));
+}
+
+static void dev_stamp_push(dev_channel_t *ch, u32 index)
+{
+    u32 head = ch->stamp_head;
+
+    /* sampling: data written while stamps FIFO is full is not measured */
+    if (head - smp_load_acquire(&ch->stamp_tail) >= LAT_STAMPS)
+        return;
+
+    ch->stamps[head % LAT_STAMPS].index = index;
+    ch->stamps[head % LAT_STAMPS].time  = ktime_get_ns();
+
+    smp_store_release(&ch->stamp_head, head + 1);
+}
+
+static void dev_stamp_pop(dev_channel_t *ch, u32 index)
+{
+    u32 tail = ch->stamp_tail;
+    u32 head = smp_load_acquire(&ch->stamp_head);
+    u64 now  = 0;
+
+    /* every write which data was completely consumed is measured */
+    while (tail != head && (s32)(ch->stamps[tail % LAT_STAMPS].index - index) <= 0) {
+        if (!now)
+            now = ktime_get_ns();
+
+        dev_hist_record(ch, LAT_RESIDENCE, now - ch->stamps[tail % LAT_STAMPS].time);
+        tail++;
+    }
+
+    smp_store_release(&ch->stamp_tail, tail);
+}
+
+static s32 dev_hist_show(struct seq_file *s, void *unused)
+{
+    static const char *names[LAT_TYPES] = {"read_wait", "write_wait", "residence"};
+    static const char *pnames[] = {"p50", "p90", "p99", "p99.9"};
+    static const u32 percentiles[] = {500, 900, 990, 999}; /* per mille */
+    dev_channel_t *ch = s->private;
+    u64 *counts, total, sum;
+    u32 type, i, p;
+
+    counts = kmalloc_array(LAT_BUCKETS, sizeof(u64), GFP_KERNEL);
+
+    if (!counts)
+        return -ENOMEM;
+
+    for (type = 0; type < LAT_TYPES; type++) {
+        dev_hist_sum(ch, type, counts);
+
+        for (i = 0, total = 0; i < LAT_BUCKETS; i++)
+            total += counts[i];
+
+        seq_printf(s, "%s: count=%llu", names[type], total);
+
+        /* percentiles are reported as bucket lower bounds */
+        for (p = 0, i = 0, sum = 0; p < ARRAY_SIZE(percentiles) && total; p++) {
+            while (i < LAT_BUCKETS && (sum + counts[i]) * 1000 < total * percentiles[p])
+                sum += counts[i++];
+
+            seq_printf(s, " %s=%lluns", pnames[p], dev_hist_lower(umin(i, LAT_BUCKETS - 1)));
+        }
+
+        seq_putc(s, '\n');
+
+        for (i = 0; i < LAT_BUCKETS; i++) {
+            if (counts[i])
+                seq_printf(s, "  >= %llu ns: %llu\n", dev_hist_lower(i), counts[i]);
+        }
+    }
+
+    kfree(counts);
+    return 0;
+}
+
+static s32 dev_hist_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, dev_hist_show, inode->i_private);
+}
+
+static ssize_t dev_hist_write(struct file *file, const char __user *buffer, size_t length, loff_t *offset)
+{
+    struct seq_file *s = file->private_data;
+
+    dev_hist_reset(s->private);
+    return length;
+}
+
+static u32 dev_bcast_head(dev_channel_t *ch)
+{
+    u32 head;
+
+    rcu_read_lock();
+    head = smp_load_acquire(&ch->ring.ctrl->head);
+    rcu_read_unlock();
+
+    return head;
+}
+
+static u32 dev_bcast_used(dev_file_t *df)
+{
+    /* overrun reader is detected by dev_bcast_overrun() before reading */
+    return umin(dev_bcast_head(df->ch) - READ_ONCE(df->cursor), READ_ONCE(df->ch->ring.size));
+}
+
+static void dev_bcast_update_tail(dev_channel_t *ch)
+{
+    dev_file_t *reader;
+    unsigned long flags;
+    u32 tail;
+
+    spin_lock_irqsave(&ch->bcast_lock, flags);
+
+    /* space is freed once the slowest reader consumed it */
+    tail = dev_bcast_head(ch);
+
+    list_for_each_entry(reader, &ch->bcast_readers, node) {
+        if ((s32)(reader->cursor - tail) < 0)
+            tail = reader->cursor;
+    }
+
+    smp_store_release(&ch->ring.ctrl->tail, tail);
+    spin_unlock_irqrestore(&ch->bcast_lock, flags);
+}
+
+static void dev_bcast_subscribe(dev_file_t *df)
+{
+    dev_channel_t *ch = df->ch;
+    unsigned long flags;
+
+    spin_lock_irqsave(&ch->bcast_lock, flags);
+
+    /* new reader receives data written from now on */
+    if (!df->subscribed) {
+        WRITE_ONCE(df->cursor, dev_bcast_head(ch));
+        list_add(&df->node, &ch->bcast_readers);
+        WRITE_ONCE(df->subscribed, true);
+    }
+
+    spin_unlock_irqrestore(&ch->bcast_lock, flags);
+}
+
+static void dev_bcast_unsubscribe(dev_file_t *df)
+{
+    dev_channel_t *ch = df->ch;
+    unsigned long flags;
+
+    spin_lock_irqsave(&ch->bcast_lock, flags);
+    list_del(&df->node);
+    WRITE_ONCE(df->subscribed, false);
+    spin_unlock_irqrestore(&ch->bcast_lock, flags);
+
+    percpu_down_read(&ch->resize_sem);
+
+    if (READ_ONCE(ch->bcast) == BCAST_BLOCK)
+        dev_bcast_update_tail(ch);
+
+    percpu_up_read(&ch->resize_sem);
+}
+
+static dev_file_t *dev_bcast_reader(dev_file_t *df)
+{
+    if (!READ_ONCE(df->ch->bcast))
+        return NULL;
+
+    /* the first read subscribes, unless IOCTL_SUBSCRIBE did it earlier */
+    if (!df->subscribed)
+        dev_bcast_subscribe(df);
+
+    return df;
+}
+
+static bool dev_bcast_overrun(dev_file_t *df)
+{
+    dev_channel_t *ch = df->ch;
+    u32 cursor = df->cursor;
+    u32 head;
+
+    /* tail passes the cursor only if writer overwrote unread data */
+    if ((s32)(READ_ONCE(ch->ring.ctrl->tail) - cursor) <= 0)
+        return false;
+
+    /* continue from the newest data, which is always at a message boundary */
+    head = smp_load_acquire(&ch->ring.ctrl->head);
+
+    WRITE_ONCE(df->lost, df->lost + head - cursor);
+    WRITE_ONCE(df->cursor, head);
+    this_cpu_add(ch->stats->lost_bytes, head - cursor);
+    return true;
+}
+
+static void dev_bcast_consume(dev_file_t *df, u32 length)
+{
+    WRITE_ONCE(df->cursor, df->cursor + length);
+
+    if (READ_ONCE(df->ch->bcast) == BCAST_BLOCK)
+        dev_bcast_update_tail(df->ch);
+}
+
+static long dev_bcast_set(dev_channel_t *ch, unsigned long mode)
+{
+    dev_file_t *reader;
+    unsigned long flags;
+    long ret = 0;
+    u32  head;
+
+    if (mode > BCAST_OVERRUN)
+        return -EINVAL;
+
+    /* no reader or writer is inside the ring buffer while mode changes */
+    percpu_down_write(&ch->resize_sem);
+
+    /* data of the shared reader must not be handed out to broadcast readers, lanes have no cursors */
+    if ((!ch->bcast && ring_used(&ch->ring)) || (mode == BCAST_OVERRUN && ch->mp_mode) || (mode && ch->lanes > 1)) {
+        ret = -EBUSY;
+        goto out;
+    }
+
+    spin_lock_irqsave(&ch->bcast_lock, flags);
+    WRITE_ONCE(ch->bcast, mode);
+
+    /* all readers start from empty ring buffer */
+    head = READ_ONCE(ch->ring.ctrl->head);
+
+    list_for_each_entry(reader, &ch->bcast_readers, node)
+        WRITE_ONCE(reader->cursor, head);
+
+    smp_store_release(&ch->ring.ctrl->tail, head);
+    spin_unlock_irqrestore(&ch->bcast_lock, flags);
+
+out:
+    dev_resize_unlock(ch);
+
+    /* waiters recheck their conditions in the new mode */
+    if (!ret) {
+        dev_wake_readers(ch);
+        dev_wake_writers(ch);
+    }
+
+    return ret;
+}
+
+static s32 dev_open(struct inode *inode, struct file *file)
+{
+    dev_channel_t *ch = container_of(inode->i_cdev, dev_channel_t, cdev);
+    dev_file_t    *df;
+
+    df = kmalloc(sizeof(dev_file_t), GFP_KERNEL);
+
+    if (!df)
+        return -ENOMEM;
+
+    /* blocking mode is taken from O_NONBLOCK, no timeouts by default */
+    df->ch            = ch;
+    df->read_timeout  = MAX_SCHEDULE_TIMEOUT;
+    df->write_timeout = MAX_SCHEDULE_TIMEOUT;
+    df->subscribed    = false;
+    df->lane          = 0;
+    df->lost          = 0;
+    mutex_init(&df->lock);
+
+    /* ring buffer follows the consumer: moved to the node of the first reader, if not in use yet */
+    if ((file->f_mode & FMODE_READ) && READ_ONCE(ch->node) == RING_NODE_READER && !xchg(&ch->placed, 1)) {
+        /* mapped or short of memory ring buffer stays in place, so the next reader tries again */
+        if (dev_ring_resize(ch, READ_ONCE(ch->ring.size), numa_node_id()))
+            WRITE_ONCE(ch->placed, 0);
+    }
+
+    trace_ldrv_open(ch->index);
+    file->private_data = df;
+
+    /* non-blocking attempts of io_uring are honored by read/write */
+    file->f_mode |= FMODE_NOWAIT;
+
+    /* device is a byte stream without file position, like a pipe */
+    return stream_open(inode, file);
+}
+
+static s32 dev_release(struct inode *inode, struct file *file)
+{
+    dev_file_t *df = file->private_data;
+
+    /* data held back by read_lowat is not left behind by a closed writer */
+    if (file->f_mode & FMODE_WRITE)
+        dev_flush(df->ch);
+
+    /* slowest broadcast reader may be gone */
+    if (df->subscribed) {
+        dev_bcast_unsubscribe(df);
+        dev_notify_writers(df->ch);
+    }
+
+    trace_ldrv_release(df->ch->index);
+    kfree(df);
+    return 0;
+}
+
+static ssize_t dev_read_locked(dev_channel_t *ch, dev_file_t *df, dev_file_t *reader, struct iov_iter *to, long *timeout)
+{
+    ring_buffer_t *rb = &ch->ring;
+    u32    used, tail, msg_len, copied, consumed;
+    bool   lossy;
+    u64    lost;
+    s32    ret;
+
+    /* broadcast reader learns about lost data before reading newer data */
+    if (reader && dev_bcast_overrun(reader))
+        return -EOVERFLOW;
+
+    lossy = !reader && READ_ONCE(ch->overwrite);
+
+    /* gap left by overwritten data is reported to the next reader once */
+    if (lossy && atomic64_read(&ch->gap)) {
+        lost = atomic64_xchg(&ch->gap, 0);
+
+        if (df)
+            WRITE_ONCE(df->lost, df->lost + lost);
+        else
+            WRITE_ONCE(ch->klost, ch->klost + lost);
+
+        return -EOVERFLOW;
+    }
+
+    if (!(used = reader ? dev_bcast_used(reader) : dev_lanes_used(ch, 0)))
+        this_cpu_inc(ch->stats->empty_events);
+
+    /* handle blocking/non-blocking mode of read operation */
+    while (!used) {
+        /* handle empty ring buffer */
+        if (!*timeout) {
+            this_cpu_inc(ch->stats->read_eagain);
+            return -EAGAIN;
+        }
+
+        /* resize must not wait for data, so ring buffer is released while sleeping */
+        percpu_up_read(&ch->resize_sem);
+        ret = dev_wait_readable(ch, reader, 1, timeout);
+        percpu_down_read(&ch->resize_sem);
+
+        if (ret)
+            return ret;
+
+        if (reader && dev_bcast_overrun(reader))
+            return -EOVERFLOW;
+
+        used = reader ? dev_bcast_used(reader) : dev_lanes_used(ch, 0);
+    }
+
+    /* the highest priority lane with data is served first */
+    if (ch->lanes > 1)
+        rb = dev_lane_ring(ch, dev_lane_pick(ch));
+
+retry:
+    if (reader)
+        tail = reader->cursor;
+    else {
+        /* occupancy is taken from the same tail snapshot, as lossy writer may move the tail at any time */
+        tail = READ_ONCE(rb->ctrl->tail);
+        used = umin(smp_load_acquire(&rb->ctrl->head) - tail, rb->size);
+    }
+
+    if (!READ_ONCE(ch->msg_mode)) {
+        /* short read in case of less data than requested */
+        ret = ring_read_stream(rb, tail, used, to);
+
+        if (ret < 0)
+            return ret;
+
+        consumed = ret;
+    }
+    else {
+        msg_len = ring_msg_len(rb, tail);
+
+        /* header of overrun broadcast reader may have been overwritten */
+        if (reader) {
+            smp_rmb();
+
+            if (dev_bcast_overrun(reader))
+                return -EOVERFLOW;
+        }
+
+        /* header may have been overwritten by lossy writer */
+        if (lossy) {
+            smp_rmb();
+
+            if (READ_ONCE(rb->ctrl->tail) != tail)
+                goto retry;
+        }
+
+        /* corrupted or too large message is left in the ring buffer */
+        ret = ring_read_msg(rb, tail, used, msg_len, to, READ_ONCE(ch->mp_mode), &consumed);
+
+        if (ret < 0)
+            return ret;
+    }
+
+    copied = ret;
+
+    if (reader) {
+        /* pairs with smp_wmb() in ring_overwrite(): copied data may have been overwritten */
+        smp_rmb();
+
+        if (dev_bcast_overrun(reader))
+            return -EOVERFLOW;
+
+        dev_bcast_consume(reader, consumed);
+    }
+    else if (lossy) {
+        /* lossy writer may have dropped the data while it was copied */
+        if (cmpxchg(&rb->ctrl->tail, tail, tail + consumed) != tail) {
+            iov_iter_revert(to, copied);
+            goto retry;
+        }
+    }
+    else
+        ring_consume(rb, consumed);
+
+    if (!reader && rb == &ch->ring && static_branch_unlikely(&dev_hist_key))
+        dev_stamp_pop(ch, tail + consumed);
+
+    this_cpu_inc(ch->stats->read_ops);
+    this_cpu_add(ch->stats->read_bytes, copied);
+    return copied;
+}
+
+static bool dev_ring_reserve(dev_channel_t *ch, u32 need, u32 *index)
+{
+    unsigned long flags;
+    bool reserved;
+
+    /* only free space check & index update are serialized, data is copied without lock */
+    spin_lock_irqsave(&ch->reserve_lock, flags);
+    reserved = ring_reserve(&ch->ring, &ch->reserve, need, index);
+    spin_unlock_irqrestore(&ch->reserve_lock, flags);
+
+    return reserved;
+}
+
+static ssize_t dev_write_reserve(dev_channel_t *ch, struct iov_iter *from, long *timeout)
+{
+    ring_buffer_t *rb = &ch->ring;
+    size_t length = iov_iter_count(from);
+    u32    need, index, copied, used;
+    s32    ret;
+
+    /* message must fit into the ring buffer as a whole */
+    if (!ring_msg_fits(rb, length))
+        return -EMSGSIZE;
+
+    need = ring_msg_size(length, true);
+
+    if (!dev_ring_reserve(ch, need, &index)) {
+        this_cpu_inc(ch->stats->full_events);
+
+        do {
+            /* handle filled ring buffer */
+            if (!*timeout) {
+                this_cpu_inc(ch->stats->write_eagain);
+                return -EAGAIN;
+            }
+
+            /* resize must not wait for free space, so ring buffer is released while sleeping */
+            percpu_up_read(&ch->resize_sem);
+            ret = dev_wait_writable(ch, 0, need, timeout);
+            percpu_down_read(&ch->resize_sem);
+
+            if (ret)
+                return ret;
+
+            /* ring buffer may have been shrunk while sleeping */
+            if (!ring_msg_fits(rb, length))
+                return -EMSGSIZE;
+        } while (!dev_ring_reserve(ch, need, &index));
+    }
+
+    copied = ring_copy_from_iter(rb, index + RING_MSG_HDR, from, length);
+
+    /* reserved slot can not be given back, so partially copied message is published as skipped */
+    ring_commit(rb, &ch->reserve, index, copied == length ? length : RING_MSG_SKIP | length);
+
+    if (copied != length)
+        return -EFAULT;
+
+    if (READ_ONCE(ch->read_lowat_msgs) > 1)
+        atomic_inc(&ch->held_msgs);
+
+    /* data without broadcast readers is dropped */
+    if (READ_ONCE(ch->bcast) == BCAST_BLOCK && list_empty(&ch->bcast_readers))
+        dev_bcast_update_tail(ch);
+
+    this_cpu_inc(ch->stats->write_ops);
+    this_cpu_add(ch->stats->write_bytes, copied);
+
+    /* occupancy high-water mark as seen by this CPU */
+    used = ring_used(rb);
+
+    if (used > this_cpu_read(ch->stats->max_used))
+        this_cpu_write(ch->stats->max_used, used);
+
+    return copied;
+}
+
+static long dev_mp_set(dev_channel_t *ch, unsigned long enable)
+{
+    ring_ctrl_t *ctrl = ch->ring.ctrl;
+    dev_file_t  *reader;
+    unsigned long flags;
+    long ret = 0;
+    u32  head;
+
+    if (enable > 1)
+        return -EINVAL;
+
+    /* no writer is between reservation and commit while mode changes */
+    percpu_down_write(&ch->resize_sem);
+
+    /* indices must not be reset under reservations of atomic kernel writers */
+    if (enable == ch->mp_mode)
+        ret = 0;
+    /* slots are framed as messages and can not be dropped by lossy writers, lanes have no reservation */
+    else if (enable && (!ch->msg_mode || ch->overwrite || ch->bcast == BCAST_OVERRUN || ch->lanes > 1))
+        ret = -EINVAL;
+    /* atomic kernel writers reserve slots without resize_sem */
+    else if (atomic_read(&ch->kusers))
+        ret = -EBUSY;
+    /* padded & not padded messages must not be mixed */
+    else if (ring_used(&ch->ring))
+        ret = -EBUSY;
+    else {
+        /* empty ring buffer starts from aligned index, so slot headers are aligned */
+        head = ALIGN(ctrl->head, RING_MSG_HDR);
+
+        spin_lock_irqsave(&ch->bcast_lock, flags);
+
+        list_for_each_entry(reader, &ch->bcast_readers, node)
+            WRITE_ONCE(reader->cursor, head);
+
+        WRITE_ONCE(ctrl->tail, head);
+        WRITE_ONCE(ctrl->head, head);
+        spin_unlock_irqrestore(&ch->bcast_lock, flags);
+
+        ch->reserve = head;
+        WRITE_ONCE(ch->mp_mode, enable);
+    }
+
+    dev_resize_unlock(ch);
+    return ret;
+}
+
+static long dev_lanes_set(dev_channel_t *ch, dev_lanes_t __user *arg)
+{
+    ring_buffer_t rings[LANES_MAX - 1] = {};
+    dev_lanes_t   cfg;
+    bool changed = false;
+    long ret = 0;
+    u32  lane;
+
+    if (copy_from_user(&cfg, arg, sizeof(dev_lanes_t)))
+        return -EFAULT;
+
+    /* SPSC mode skips the lane locks, which keep lane ring buffers alive */
+    if (!cfg.lanes || cfg.lanes > LANES_MAX || (cfg.lanes > 1 && spsc_mode))
+        return -EINVAL;
+
+    /* lanes have the size of the channel ring buffer, allocated without stopping data path */
+    for (lane = 1; lane < cfg.lanes; lane++) {
+        if (ring_alloc(&rings[lane - 1], READ_ONCE(ch->ring.size), READ_ONCE(ch->ring.node))) {
+            ret = -ENOMEM;
+            goto free;
+        }
+    }
+
+    percpu_down_write(&ch->resize_sem);
+
+    /* lanes are served by plain reads & writes only */
+    if (cfg.lanes > 1 && (ch->bcast || ch->mp_mode || ch->overwrite))
+        ret = -EINVAL;
+    /* mappings expose lane 0 only, blocked lane writers hold their lane lock */
+    else if (cfg.lanes > 1 && atomic_read(&ch->mmaps))
+        ret = -EBUSY;
+    else if (cfg.lanes != ch->lanes) {
+        for (lane = 1; lane < LANES_MAX; lane++) {
+            if (mutex_is_locked(&ch->prio[lane - 1].write_lock))
+                ret = -EBUSY;
+        }
+
+        /* queued messages must not change their lane */
+        if (ret || dev_lanes_used(ch, 1))
+            ret = -EBUSY;
+        else {
+            /* removed lanes end up in rings and are freed below */
+            for (lane = 1; lane < LANES_MAX; lane++)
+                swap(ch->prio[lane - 1].ring, rings[lane - 1]);
+
+            /* pairs with smp_load_acquire() of lockless observers */
+            smp_store_release(&ch->lanes, cfg.lanes);
+            changed = true;
+        }
+    }
+
+    if (!ret) {
+        for (lane = 0; lane < LANES_MAX; lane++) {
+            ch->lane_weight[lane] = cfg.weights[lane];
+            ch->lane_served[lane] = 0;
+        }
+    }
+
+    dev_resize_unlock(ch);
+
+    if (changed) {
+        /* writers recheck their lanes, lockless observers are done with removed lanes */
+        dev_wake_readers(ch);
+        dev_wake_writers(ch);
+        synchronize_rcu();
+    }
+
+free:
+    for (lane = 1; lane < LANES_MAX; lane++)
+        ring_destroy(&rings[lane - 1]);
+
+    return ret;
+}
+
+static ssize_t dev_write_locked(dev_channel_t *ch, u32 lane, struct iov_iter *from, long *timeout)
+{
+    ring_buffer_t *rb = dev_lane_ring(ch, lane);
+    size_t length = iov_iter_count(from);
+    u32    need, avail, head, produced, used;
+    bool   msg_mode, lossy;
+    ssize_t copied;
+    s32    bcast, ret;
+
+    /* concurrent writers do not take the write side lock */
+    if (READ_ONCE(ch->mp_mode))
+        return dev_write_reserve(ch, from, timeout);
+
+    msg_mode = READ_ONCE(ch->msg_mode);
+    bcast    = READ_ONCE(ch->bcast);
+    lossy    = bcast == BCAST_OVERRUN || (!bcast && READ_ONCE(ch->overwrite));
+
+    /* message must fit into the ring buffer as a whole */
+    if (msg_mode && !ring_msg_fits(rb, length))
+        return -EMSGSIZE;
+
+    need = msg_mode ? ring_msg_size(length, false) : 1;
+
+    /* lossy writer never waits, it overwrites the oldest data instead */
+    if ((avail = lossy ? rb->size : ring_free(rb)) < need)
+        this_cpu_inc(ch->stats->full_events);
+
+    /* handle blocking/non-blocking mode of write operation */
+    while (avail < need) {
+        /* handle filled ring buffer */
+        if (!*timeout) {
+            this_cpu_inc(ch->stats->write_eagain);
+            return -EAGAIN;
+        }
+
+        /* resize must not wait for free space, so ring buffer is released while sleeping */
+        percpu_up_read(&ch->resize_sem);
+        ret = dev_wait_writable(ch, lane, need, timeout);
+        percpu_down_read(&ch->resize_sem);
+
+        if (ret)
+            return ret;
+
+        /* ring buffer may have been shrunk while sleeping */
+        if (msg_mode && !ring_msg_fits(rb, length))
+            return -EMSGSIZE;
+
+        bcast = READ_ONCE(ch->bcast);
+        lossy = bcast == BCAST_OVERRUN || (!bcast && READ_ONCE(ch->overwrite));
+        avail = lossy ? rb->size : ring_free(rb);
+    }
+
+    head = READ_ONCE(rb->ctrl->head);
+
+    if (bcast == BCAST_OVERRUN)
+        ring_overwrite(rb, head + (msg_mode ? need : umin(length, avail)));
+    else if (lossy)
+        dev_ring_drop(ch, msg_mode ? need : umin(length, avail), msg_mode);
+
+    /* short write in case of less free space, message is published only if it was copied in completely */
+    copied = msg_mode ? ring_write_msg(rb, head, from) : ring_write_stream(rb, head, avail, from);
+
+    if (copied < 0)
+        return copied;
+
+    produced = msg_mode ? need : copied;
+
+    /* stamp is published before data, so reader can not miss it (stamps follow lane 0 only) */
+    if (!lane && static_branch_unlikely(&dev_hist_key))
+        dev_stamp_push(ch, head + produced);
+
+    ring_produce(rb, produced);
+
+    if (msg_mode && READ_ONCE(ch->read_lowat_msgs) > 1)
+        atomic_inc(&ch->held_msgs);
+
+    /* data without broadcast readers is dropped */
+    if (bcast == BCAST_BLOCK && list_empty(&ch->bcast_readers))
+        dev_bcast_update_tail(ch);
+
+    this_cpu_inc(ch->stats->write_ops);
+    this_cpu_add(ch->stats->write_bytes, copied);
+
+    /* lane writers are serialized by the lane lock */
+    if (ch->lanes > 1)
+        ch->lane_writes[lane]++;
+
+    /* occupancy high-water mark as seen by this CPU, lossy writer has no free space estimate */
+    used = ring_used(rb);
+
+    if (used > this_cpu_read(ch->stats->max_used))
+        this_cpu_write(ch->stats->max_used, used);
+
+    return copied;
+}
+
+static ssize_t dev_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    dev_file_t    *df = iocb->ki_filp->private_data;
+    dev_channel_t *ch = df->ch;
+    size_t  length = iov_iter_count(to);
+    dev_file_t   *reader;
+    struct mutex *lock;
+    ssize_t bytes_read;
+    long    timeout;
+    bool    nowait;
+    s32     ret;
+
+    if (!length)
+        return 0;
+
+    nowait  = (READ_ONCE(iocb->ki_filp->f_flags) & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT);
+    timeout = nowait ? 0 : READ_ONCE(df->read_timeout);
+    reader  = dev_bcast_reader(df);
+    lock    = reader ? &df->lock : &ch->read_lock;
+    ret     = dev_lock_side(ch, lock, nowait);
+
+    if (ret)
+        return ret;
+
+    bytes_read = dev_read_locked(ch, df, reader, to, &timeout);
+
+    dev_unlock_side(ch, lock);
+
+    /* ring buffer fill level is computed only for an enabled tracepoint */
+    if (trace_ldrv_read_enabled())
+        trace_ldrv_read(ch->index, length, bytes_read, dev_ring_used(ch));
+
+    if (bytes_read < 0)
+        return bytes_read;
+
+    dev_notify_writers(ch);
+    dev_op_info_update(&ch->last_read);
+    return bytes_read;
+}
+
+static ssize_t dev_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    dev_file_t    *df = iocb->ki_filp->private_data;
+    dev_channel_t *ch = df->ch;
+    size_t  length = iov_iter_count(from);
+    struct mutex *lock;
+    ssize_t bytes_written;
+    long    timeout;
+    bool    nowait;
+    u32     lane;
+    s32     ret;
+
+    if (!length)
+        return 0;
+
+    nowait  = (READ_ONCE(iocb->ki_filp->f_flags) & O_NONBLOCK) || (iocb->ki_flags & IOCB_NOWAIT);
+    timeout = nowait ? 0 : READ_ONCE(df->write_timeout);
+    ret     = dev_lock_writer(ch, df, nowait, &lock, &lane);
+
+    if (ret)
+        return ret;
+
+    bytes_written = dev_write_locked(ch, lane, from, &timeout);
+
+    dev_unlock_side(ch, lock);
+
+    if (trace_ldrv_write_enabled())
+        trace_ldrv_write(ch->index, length, bytes_written, dev_ring_used(ch));
+
+    if (bytes_written < 0)
+        return bytes_written;
+
+    dev_notify_readers(ch);
+    dev_op_info_update(&ch->last_write);
+    return bytes_written;
+}
+
+static long dev_msg_batch(struct file *file, dev_msg_batch_t __user *arg, bool recv)
+{
+    dev_file_t    *df = file->private_data;
+    dev_channel_t *ch = df->ch;
+    dev_msg_t __user *msgs;
+    struct mutex     *lock;
+    struct iov_iter  iter;
+    dev_msg_batch_t  batch;
+    dev_msg_t        msg;
+    ssize_t ret = 0;
+    long    timeout;
+    bool    nowait;
+    u32     done, lane;
+
+    /* broadcast readers use read() with their own cursors */
+    if (!READ_ONCE(ch->msg_mode) || (recv && READ_ONCE(ch->bcast)))
+        return -EINVAL;
+
+    if (copy_from_user(&batch, arg, sizeof(dev_msg_batch_t)))
+        return -EFAULT;
+
+    msgs    = u64_to_user_ptr(batch.msgs);
+    lock    = &ch->read_lock;
+    lane    = 0;
+    nowait  = READ_ONCE(file->f_flags) & O_NONBLOCK;
+    timeout = nowait ? 0 : READ_ONCE(recv ? df->read_timeout : df->write_timeout);
+    ret     = recv ? dev_lock_side(ch, lock, nowait) : dev_lock_writer(ch, df, nowait, &lock, &lane);
+
+    if (ret)
+        return ret;
+
+    for (done = 0; done < umin(batch.count, MAX_BATCH); done++) {
+        if (copy_from_user(&msg, &msgs[done], sizeof(dev_msg_t))) {
+            ret = -EFAULT;
+            break;
+        }
+
+        ret = import_ubuf(recv ? ITER_DEST : ITER_SOURCE, u64_to_user_ptr(msg.buf), msg.len, &iter);
+
+        if (ret)
+            break;
+
+        /* block only for the first message, then take what is available */
+        if (done)
+            timeout = 0;
+
+        if (recv)
+            ret = dev_read_locked(ch, df, NULL, &iter, &timeout);
+        else
+            ret = dev_write_locked(ch, lane, &iter, &timeout);
+
+        if (ret < 0)
+            break;
+
+        if (recv && put_user((u32)ret, &msgs[done].len)) {
+            ret = -EFAULT;
+            done++;
+            break;
+        }
+    }
+
+    dev_unlock_side(ch, lock);
+
+    if (!done)
+        return ret;
+
+    /* one wake up for the whole batch */
+    if (recv) {
+        dev_notify_writers(ch);
+        dev_op_info_update(&ch->last_read);
+    }
+    else {
+        dev_notify_readers(ch);
+        dev_op_info_update(&ch->last_write);
+    }
+
+    return done;
+}
+
+static __poll_t dev_poll(struct file *file, poll_table *wait)
+{
+    dev_file_t    *df = file->private_data;
+    dev_channel_t *ch = df->ch;
+    __poll_t mask = 0;
+    u32 used;
+
+    /* register on both queues before checking the ring buffer state */
+    poll_wait(file, &ch->read_queue, wait);
+    poll_wait(file, &ch->write_queue, wait);
+
+    /* poll does not subscribe, cursor of a polling writer would hold the tail */
+    if (READ_ONCE(ch->bcast))
+        used = READ_ONCE(df->subscribed) ? dev_bcast_used(df) : 0;
+    else
+        used = dev_ring_used(ch);
+
+    if (used)
+        mask |= EPOLLIN | EPOLLRDNORM;
+
+    /* urgent data is queued in a priority lane */
+    if (READ_ONCE(ch->lanes) > 1) {
+        rcu_read_lock();
+
+        if (dev_lanes_used(ch, 1))
+            mask |= EPOLLPRI;
+
+        rcu_read_unlock();
+    }
+
+    /* in message mode at least an empty message must fit into the lane of the file */
+    if (READ_ONCE(ch->bcast) == BCAST_OVERRUN || READ_ONCE(ch->overwrite) ||
+        dev_lane_free(ch, dev_file_lane(ch, df)) > (READ_ONCE(ch->msg_mode) ? RING_MSG_HDR : 0))
+        mask |= EPOLLOUT | EPOLLWRNORM;
+
+    return mask;
+}
+
+static s32 dev_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    dev_channel_t *ch = ((dev_file_t *)file->private_data)->ch;
+    ring_buffer_t *rb = &ch->ring;
+    unsigned long addr, pgoff;
+    struct page *page;
+    u32 pages;
+    s32 ret = 0;
+
+    /* ring buffer must not be replaced by resize until the mapping is counted */
+    percpu_down_read(&ch->resize_sem);
+
+    pages = rb->size >> PAGE_SHIFT;
+
+    /* area must not exceed control page & data pages mapped twice */
+    if (vma->vm_pgoff + vma_pages(vma) > 1 + 2 * pages)
+        ret = -EINVAL;
+
+    /* mapping would bypass priority lanes */
+    if (ch->lanes > 1)
+        ret = -EBUSY;
+
+    vm_flags_set(vma, VM_DONTEXPAND | VM_DONTDUMP);
+
+    for (addr = vma->vm_start, pgoff = vma->vm_pgoff; !ret && addr < vma->vm_end; addr += PAGE_SIZE, pgoff++) {
+        page = pgoff ? rb->pages[(pgoff - 1) & (pages - 1)] : vmalloc_to_page(rb->ctrl);
+        ret  = vm_insert_page(vma, addr, page);
+    }
+
+    if (!ret) {
+        vma->vm_ops          = &dev_vm_ops;
+        vma->vm_private_data = ch;
+        dev_vm_open(vma);
+    }
+
+    percpu_up_read(&ch->resize_sem);
+
+    if (ret)
+        pr_err_ratelimited(DRIVER_NAME ": %s\n", "failed to map ring buffer to user space");
+
+    return ret;
+}
+
+static void dev_vm_open(struct vm_area_struct *vma)
+{
+    dev_channel_t *ch = vma->vm_private_data;
+
+    atomic_inc(&ch->mmaps);
+}
+
+static void dev_vm_close(struct vm_area_struct *vma)
+{
+    dev_channel_t *ch = vma->vm_private_data;
+
+    atomic_dec(&ch->mmaps);
+}
+
+#ifdef CONFIG_IO_URING
+static s32 dev_uring_issue(dev_channel_t *ch, struct io_uring_cmd *ioucmd)
+{
+    dev_uring_pdu_t *pdu = (dev_uring_pdu_t *)ioucmd->pdu;
+    dev_file_t      *df  = ioucmd->file->private_data;
+    struct mutex    *lock;
+    struct iov_iter iter;
+    long timeout = 0;
+    u32  lane;
+    s32  ret;
+
+    switch (ioucmd->cmd_op) {
+        case URING_CMD_ENQUEUE:
+            ret = import_ubuf(ITER_SOURCE, u64_to_user_ptr(pdu->buf), pdu->len, &iter);
+
+            if (ret)
+                return ret;
+
+            if (!iov_iter_count(&iter))
+                return 0;
+
+            /* lock contention is not a full ring buffer, free space would not help */
+            ret = dev_lock_writer(ch, df, true, &lock, &lane);
+
+            if (ret)
+                return ret == -EAGAIN ? -EBUSY : ret;
+
+            ret = dev_write_locked(ch, lane, &iter, &timeout);
+            dev_unlock_side(ch, lock);
+
+            if (ret > 0) {
+                dev_notify_readers(ch);
+                dev_op_info_update(&ch->last_write);
+            }
+
+            return ret;
+
+        case URING_CMD_DEQUEUE:
+            /* broadcast readers use io_uring read with their own cursors */
+            if (READ_ONCE(ch->bcast))
+                return -EINVAL;
+
+            ret = import_ubuf(ITER_DEST, u64_to_user_ptr(pdu->buf), pdu->len, &iter);
+
+            if (ret)
+                return ret;
+
+            if (!iov_iter_count(&iter))
+                return 0;
+
+            ret = dev_lock_side(ch, &ch->read_lock, true);
+
+            if (ret)
+                return ret == -EAGAIN ? -EBUSY : ret;
+
+            ret = dev_read_locked(ch, df, NULL, &iter, &timeout);
+            dev_unlock_side(ch, &ch->read_lock);
+
+            if (ret > 0) {
+                dev_notify_writers(ch);
+                dev_op_info_update(&ch->last_read);
+            }
+
+            return ret;
+
+        case URING_CMD_WAIT_READ:
+            /* wait for data written through the shared mapping, like IOCTL_WAIT_READ */
+            dev_bcast_reader(df);
+            return dev_uring_ready(ch, ioucmd) ? 0 : -EAGAIN;
+
+        case URING_CMD_WAIT_WRITE:
+            return dev_uring_ready(ch, ioucmd) ? 0 : -EAGAIN;
+
+        default:
+            return -EINVAL;
+    }
+}
+
+static bool dev_uring_ready(dev_channel_t *ch, struct io_uring_cmd *ioucmd)
+{
+    dev_uring_pdu_t *pdu = (dev_uring_pdu_t *)ioucmd->pdu;
+    dev_file_t      *df  = ioucmd->file->private_data;
+    u32 count, lane;
+
+    count = clamp_t(u32, pdu->len, 1, READ_ONCE(ch->ring.size));
+    lane  = dev_file_lane(ch, df);
+
+    switch (ioucmd->cmd_op) {
+        case URING_CMD_DEQUEUE:
+            return dev_ring_used(ch) != 0;
+
+        case URING_CMD_ENQUEUE:
+            /* message must fit as a whole */
+            return dev_lane_free(ch, lane) >= (READ_ONCE(ch->msg_mode) ? RING_MSG_HDR + pdu->len : 1);
+
+        case URING_CMD_WAIT_READ:
+            /* broadcast reader has its own cursor, subscribed at issue */
+            if (READ_ONCE(ch->bcast))
+                return READ_ONCE(df->subscribed) && dev_bcast_used(df) >= count;
+
+            return dev_ring_used(ch) >= count;
+
+        case URING_CMD_WAIT_WRITE:
+            return dev_lane_free(ch, lane) >= count;
+
+        default:
+            return true;
+    }
+}
+
+static s32 dev_uring_park(dev_channel_t *ch, struct io_uring_cmd *ioucmd, u32 issue_flags, bool contended)
+{
+    dev_uring_pdu_t  *pdu = (dev_uring_pdu_t *)ioucmd->pdu;
+    struct list_head *list;
+    struct mutex     *lock;
+    unsigned long    flags;
+    u32 lane;
+
+    if (contended)
+        list = &ch->uring_lockers;
+    else if (ioucmd->cmd_op == URING_CMD_DEQUEUE || ioucmd->cmd_op == URING_CMD_WAIT_READ)
+        list = &ch->uring_readers;
+    else
+        list = &ch->uring_writers;
+
+    /* command must be cancelable before dev_uring_kick() can see it */
+    io_uring_cmd_mark_cancelable(ioucmd, issue_flags);
+
+    spin_lock_irqsave(&ch->uring_lock, flags);
+    list_add_tail(&pdu->node, list);
+    spin_unlock_irqrestore(&ch->uring_lock, flags);
+
+    /* pairs with the barrier in dev_uring_kick() after index update or unlock */
+    smp_mb();
+
+    if (!contended) {
+        /* ring buffer could become ready before the command was parked */
+        if (dev_uring_ready(ch, ioucmd))
+            dev_uring_kick(ch, list);
+
+        return -EIOCBQUEUED;
+    }
+
+    /* lock could be released before the command was parked, then unlock retries it */
+    if (ioucmd->cmd_op == URING_CMD_DEQUEUE) {
+        lock = &ch->read_lock;
+
+        if (!dev_lock_side(ch, lock, true))
+            dev_unlock_side(ch, lock);
+    }
+    else if (!dev_lock_writer(ch, ioucmd->file->private_data, true, &lock, &lane))
+        dev_unlock_side(ch, lock);
+
+    return -EIOCBQUEUED;
+}
+
+static void dev_uring_kick(dev_channel_t *ch, struct list_head *list)
+{
+    struct io_uring_cmd *ioucmd;
+    dev_uring_pdu_t     *pdu;
+    unsigned long       flags;
+
+    /* pairs with the barrier in dev_uring_park() */
+    smp_mb();
+
+    if (list_empty(list))
+        return;
+
+    for (;;) {
+        spin_lock_irqsave(&ch->uring_lock, flags);
+        pdu = list_first_entry_or_null(list, dev_uring_pdu_t, node);
+
+        if (pdu)
+            list_del_init(&pdu->node);
+
+        spin_unlock_irqrestore(&ch->uring_lock, flags);
+
+        if (!pdu)
+            break;
+
+        /* retry the command in the context of the submitting task */
+        ioucmd = (struct io_uring_cmd *)((char *)pdu - offsetof(struct io_uring_cmd, pdu));
+        io_uring_cmd_complete_in_task(ioucmd, dev_uring_task_cb);
+    }
+}
+
+static void dev_uring_task_cb(struct io_uring_cmd *ioucmd, u32 issue_flags)
+{
+    dev_channel_t *ch = ((dev_file_t *)ioucmd->file->private_data)->ch;
+    s32 ret;
+
+    ret = dev_uring_issue(ch, ioucmd);
+
+    /* lost the race with another reader/writer */
+    if (ret == -EAGAIN || ret == -EBUSY)
+        ret = dev_uring_park(ch, ioucmd, issue_flags, ret == -EBUSY);
+
+    if (ret != -EIOCBQUEUED)
+        io_uring_cmd_done(ioucmd, ret, 0, issue_flags);
+}
+
+static s32 dev_uring_cmd(struct io_uring_cmd *ioucmd, u32 issue_flags)
+{
+    dev_channel_t    *ch  = ((dev_file_t *)ioucmd->file->private_data)->ch;
+    dev_uring_pdu_t  *pdu = (dev_uring_pdu_t *)ioucmd->pdu;
+    const dev_uring_cmd_t *cmd;
+    unsigned long    flags;
+    bool             parked;
+    s32              ret;
+
+    BUILD_BUG_ON(sizeof(dev_uring_pdu_t) > sizeof(ioucmd->pdu));
+
+    /* io_uring instance is going away */
+    if (issue_flags & IO_URING_F_CANCEL) {
+        spin_lock_irqsave(&ch->uring_lock, flags);
+        parked = !list_empty(&pdu->node);
+        list_del_init(&pdu->node);
+        spin_unlock_irqrestore(&ch->uring_lock, flags);
+
+        if (parked)
+            io_uring_cmd_done(ioucmd, -ECANCELED, 0, issue_flags);
+
+        return 0;
+    }
+
+    /* SQE can be reused by user space once the command goes asynchronous */
+    cmd = io_uring_sqe_cmd(ioucmd->sqe);
+
+    pdu->buf = READ_ONCE(cmd->buf);
+    pdu->len = READ_ONCE(cmd->len);
+    INIT_LIST_HEAD(&pdu->node);
+
+    ret = dev_uring_issue(ch, ioucmd);
+
+    /* complete asynchronously once the ring buffer is ready or the lock is released */
+    if (ret == -EAGAIN || ret == -EBUSY)
+        ret = dev_uring_park(ch, ioucmd, issue_flags, ret == -EBUSY);
+
+    return ret;
+}
+#else
+static void dev_uring_kick(dev_channel_t *ch, struct list_head *list)
+{
+    /* io_uring is disabled, no commands can be parked */
+}
+#endif /* CONFIG_IO_URING */
+
+static long dev_hist_copy(dev_channel_t *ch, dev_lat_hist_t __user *arg)
+{
+    dev_lat_hist_t *hist;
+    long ret = 0;
+
+    /* too large for kernel stack */
+    hist = kmalloc(sizeof(dev_lat_hist_t), GFP_KERNEL);
+
+    if (!hist)
+        return -ENOMEM;
+
+    if (get_user(hist->type, &arg->type)) {
+        ret = -EFAULT;
+        goto free_hist;
+    }
+
+    if (hist->type >= LAT_TYPES) {
+        ret = -EINVAL;
+        goto free_hist;
+    }
+
+    hist->pad = 0;
+    dev_hist_sum(ch, hist->type, hist->counts);
+
+    if (copy_to_user(arg, hist, sizeof(dev_lat_hist_t)))
+        ret = -EFAULT;
+
+free_hist:
+    kfree(hist);
+    return ret;
+}
+
+static long dev_timeout(unsigned long msecs)
+{
+    if (!msecs)
+        return MAX_SCHEDULE_TIMEOUT;
+
+    return msecs_to_jiffies(umin(msecs, UINT_MAX));
+}
+
+static long dev_ioctl(struct file *file, u32 cmd, unsigned long arg)
+{
+    dev_file_t    *df = file->private_data;
+    dev_channel_t *ch = df->ch;
+    dev_buf_info_t info;
+    long timeout;
+    long ret = 0;
+    
+    switch (cmd) {
+        case IOCTL_BLOCK:
+            /* same as fcntl(F_SETFL) without O_NONBLOCK, affects only this file */
+            spin_lock(&file->f_lock);
+            file->f_flags &= ~O_NONBLOCK;
+            spin_unlock(&file->f_lock);
+            break;
+        
+        case IOCTL_NONBLOCK:
+            spin_lock(&file->f_lock);
+            file->f_flags |= O_NONBLOCK;
+            spin_unlock(&file->f_lock);
+            break;
+        
+        case IOCTL_BUFINFO:
+            info.last_read_time   = ch->last_read.time;
+            info.last_read_pid    = ch->last_read.pid;
+            info.last_read_owner  = ch->last_read.owner;
+            info.last_write_time  = ch->last_write.time;
+            info.last_write_pid   = ch->last_write.pid;
+            info.last_write_owner = ch->last_write.owner;
+
+            if (copy_to_user((dev_buf_info_t *)arg, &info, sizeof(dev_buf_info_t)))
+                ret = -EFAULT;
+
+            break;
+    
+        case IOCTL_WAIT_READ:
+            /* wait for data written through the shared mapping */
+            timeout = READ_ONCE(df->read_timeout);
+            ret     = dev_wait_readable(ch, dev_bcast_reader(df), clamp_t(unsigned long, arg, 1, READ_ONCE(ch->ring.size)), &timeout);
+            break;
+
+        case IOCTL_WAIT_WRITE:
+            /* wait for space freed through the shared mapping */
+            timeout = READ_ONCE(df->write_timeout);
+            ret     = dev_wait_writable(ch, dev_file_lane(ch, df), clamp_t(unsigned long, arg, 1, READ_ONCE(ch->ring.size)), &timeout);
+            break;
+
+        case IOCTL_WAKE:
+            /* user space side advanced head or tail */
+            dev_wake_readers(ch);
+            dev_wake_writers(ch);
+            break;
+
+        case IOCTL_MSG_MODE:
+            /* records of different modes must not be mixed */
+            if (dev_ring_used(ch) || (!arg && READ_ONCE(ch->mp_mode)))
+                ret = -EBUSY;
+            else
+                WRITE_ONCE(ch->msg_mode, !!arg);
+
+            break;
+
+        case IOCTL_SEND_BATCH:
+            ret = dev_msg_batch(file, (dev_msg_batch_t __user *)arg, false);
+            break;
+
+        case IOCTL_RECV_BATCH:
+            ret = dev_msg_batch(file, (dev_msg_batch_t __user *)arg, true);
+            break;
+
+        case IOCTL_LAT_HIST:
+            ret = dev_hist_copy(ch, (dev_lat_hist_t __user *)arg);
+            break;
+
+        case IOCTL_LAT_RESET:
+            dev_hist_reset(ch);
+            break;
+
+        case IOCTL_RESIZE:
+            /* ring buffer is allocated by driver, so its size is limited to privileged users */
+            if (!capable(CAP_SYS_ADMIN))
+                ret = -EPERM;
+            else
+                ret = dev_ring_resize(ch, arg, READ_ONCE(ch->ring.node));
+
+            break;
+
+        case IOCTL_READ_TIMEOUT:
+            WRITE_ONCE(df->read_timeout, dev_timeout(arg));
+            break;
+
+        case IOCTL_WRITE_TIMEOUT:
+            WRITE_ONCE(df->write_timeout, dev_timeout(arg));
+            break;
+
+        case IOCTL_BUSY_POLL:
+            ret = dev_busy_poll_set(ch, arg);
+            break;
+
+        case IOCTL_LOWAT:
+            ret = dev_lowat_set(ch, (dev_lowat_t __user *)arg);
+            break;
+
+        case IOCTL_FLUSH:
+            dev_flush(ch);
+            break;
+
+        case IOCTL_BROADCAST:
+            ret = dev_bcast_set(ch, arg);
+            break;
+
+        case IOCTL_SUBSCRIBE:
+            if (!READ_ONCE(ch->bcast) || !(file->f_mode & FMODE_READ))
+                ret = -EINVAL;
+            else
+                dev_bcast_subscribe(df);
+
+            break;
+
+        case IOCTL_OVERWRITE:
+            if (arg > 1)
+                ret = -EINVAL;
+            /* reserved slots of multi-producer writers & lanes can not be dropped */
+            else if (arg && (READ_ONCE(ch->mp_mode) || READ_ONCE(ch->lanes) > 1))
+                ret = -EBUSY;
+            else
+                WRITE_ONCE(ch->overwrite, arg);
+
+            /* blocked writers continue by overwriting */
+            if (arg == 1 && !ret)
+                dev_wake_writers(ch);
+
+            break;
+
+        case IOCTL_MP_MODE:
+            ret = dev_mp_set(ch, arg);
+            break;
+
+        case IOCTL_NUMA_NODE:
+            /* placement reallocates the ring buffer like resize */
+            if (!capable(CAP_SYS_ADMIN))
+                ret = -EPERM;
+            else
+                ret = dev_ring_place(ch, (long)arg);
+
+            break;
+
+        case IOCTL_LANES:
+            /* every lane allocates a ring buffer of channel size */
+            if (!capable(CAP_SYS_ADMIN))
+                ret = -EPERM;
+            else
+                ret = dev_lanes_set(ch, (dev_lanes_t __user *)arg);
+
+            break;
+
+        case IOCTL_LANE:
+            if (arg >= LANES_MAX)
+                ret = -EINVAL;
+            else
+                WRITE_ONCE(df->lane, arg);
+
+            break;
+
+        case IOCTL_LOST:
+            if (put_user(READ_ONCE(df->lost), (u64 __user *)arg))
+                ret = -EFAULT;
+
+            break;
+
+        default:
+            ret = -EINVAL;
+            break;
+    }
+
+    trace_ldrv_ioctl(ch->index, cmd, arg, ret);
+    return ret;
+}
+
+struct ldrv_channel *ldrv_channel_get(u32 index)
+{
+    dev_channel_t *ch;
+
+    if (!channels || index >= (u32)num_channels)
+        return ERR_PTR(-ENODEV);
+
+    ch = &channels[index];
+
+    /* resize either sees the user or has finished before it */
+    percpu_down_read(&ch->resize_sem);
+    atomic_inc(&ch->kusers);
+    percpu_up_read(&ch->resize_sem);
+
+    return ch;
+}
+EXPORT_SYMBOL_GPL(ldrv_channel_get);
+
+void ldrv_channel_put(struct ldrv_channel *ch)
+{
+    atomic_dec(&ch->kusers);
+}
+EXPORT_SYMBOL_GPL(ldrv_channel_put);
+
+static ssize_t dev_kernel_write(dev_channel_t *ch, const struct kvec *vec, u32 count, u32 flags, u32 *done)
+{
+    struct iov_iter iter;
+    ssize_t ret = 0;
+    long    timeout;
+    bool    atomic;
+
+    atomic  = flags & LDRV_ATOMIC;
+    timeout = atomic || (flags & LDRV_NOWAIT) ? 0 : MAX_SCHEDULE_TIMEOUT;
+    *done   = 0;
+
+    /* side lock is a mutex, even its trylock is not allowed in interrupt context */
+    if (!atomic && in_interrupt())
+        return -EINVAL;
+
+    if (atomic) {
+        /* only slot reservation can be done without sleeping lock */
+        if (!READ_ONCE(ch->mp_mode))
+            return -EINVAL;
+    }
+    else {
+        ret = dev_lock_side(ch, &ch->write_lock, !timeout);
+
+        if (ret)
+            return ret;
+    }
+
+    for (; *done < count; (*done)++) {
+        iov_iter_kvec(&iter, ITER_SOURCE, &vec[*done], 1, vec[*done].iov_len);
+
+        /* block only for the first message, then take what fits */
+        if (*done)
+            timeout = 0;
+
+        ret = atomic ? dev_write_reserve(ch, &iter, &timeout) : dev_write_locked(ch, 0, &iter, &timeout);
+
+        if (ret < 0)
+            break;
+    }
+
+    if (!atomic)
+        dev_unlock_side(ch, &ch->write_lock);
+
+    /* one wake up for the whole batch */
+    if (*done)
+        dev_notify_readers(ch);
+
+    return ret;
+}
+
+ssize_t ldrv_enqueue(struct ldrv_channel *ch, const void *buf, size_t len, u32 flags)
+{
+    struct kvec vec = {.iov_base = (void *)buf, .iov_len = len};
+    u32 done;
+
+    if (!len)
+        return 0;
+
+    return dev_kernel_write(ch, &vec, 1, flags, &done);
+}
+EXPORT_SYMBOL_GPL(ldrv_enqueue);
+
+int ldrv_enqueue_batch(struct ldrv_channel *ch, const struct kvec *vec, u32 count, u32 flags)
+{
+    ssize_t ret;
+    u32     done;
+
+    count = umin(count, MAX_BATCH);
+    ret   = dev_kernel_write(ch, vec, count, flags, &done);
+
+    return done ? done : ret;
+}
+EXPORT_SYMBOL_GPL(ldrv_enqueue_batch);
+
+ssize_t ldrv_dequeue(struct ldrv_channel *ch, void *buf, size_t len, u32 flags)
+{
+    struct kvec     vec = {.iov_base = buf, .iov_len = len};
+    struct iov_iter iter;
+    ssize_t ret;
+    long    timeout;
+
+    /* readers sleep on read_lock, broadcast readers are opened files */
+    if ((flags & LDRV_ATOMIC) || in_interrupt() || READ_ONCE(ch->bcast))
+        return -EINVAL;
+
+    if (!len)
+        return 0;
+
+    timeout = (flags & LDRV_NOWAIT) ? 0 : MAX_SCHEDULE_TIMEOUT;
+    ret     = dev_lock_side(ch, &ch->read_lock, !timeout);
+
+    if (ret)
+        return ret;
+
+    iov_iter_kvec(&iter, ITER_DEST, &vec, 1, len);
+    ret = dev_read_locked(ch, NULL, NULL, &iter, &timeout);
+
+    dev_unlock_side(ch, &ch->read_lock);
+
+    if (ret > 0)
+        dev_notify_writers(ch);
+
+    return ret;
+}
+EXPORT_SYMBOL_GPL(ldrv_dequeue);
+
+u64 ldrv_lost(struct ldrv_channel *ch)
+{
+    return READ_ONCE(ch->klost);
+}
+EXPORT_SYMBOL_GPL(ldrv_lost);
+
 /* Register initialization and exit functions */
 module_init(linux_driver_init);
 module_exit(linux_driver_exit);
\ No newline at end of file
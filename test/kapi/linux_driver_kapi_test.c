@@ -0,0 +1,101 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST KERNEL API (include/linux_driver_api.h) FROM ANOTHER MODULE */
+
+#include <linux/module.h>
+#include <linux/string.h>
+#include <linux/err.h>
+#include <linux/uio.h>
+
+#include "../../include/linux_driver_api.h"
+
+#define TEST_NAME "linux_driver_kapi_test"
+
+/* report failed check, module refuses to load if any check fails */
+#define KAPI_CHECK(cond, descr)                                        \
+    do {                                                               \
+        if (!(cond)) {                                                 \
+            printk(KERN_ERR TEST_NAME ": %s failed\n", descr);         \
+            err = -EINVAL;                                             \
+        }                                                              \
+    } while (0)
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Alexander (@alkuzin)");
+MODULE_DESCRIPTION("Test of linux driver kernel API");
+
+static s32 __init kapi_test_init(void)
+{
+    static const char *parts[] = {"kernel", " batch", " message"};
+    static const char message[] = "kernel message";
+    struct ldrv_channel *ch;
+    struct kvec vec[ARRAY_SIZE(parts)];
+    char buffer[32];
+    ssize_t ret;
+    s32 err = 0;
+    u32 i;
+
+    ch = ldrv_channel_get(U32_MAX);
+    KAPI_CHECK(PTR_ERR_OR_ZERO(ch) == -ENODEV, "get of incorrect channel");
+
+    ch = ldrv_channel_get(0);
+
+    if (IS_ERR(ch))
+        return PTR_ERR(ch);
+
+    /* channel 0 is expected empty, in byte stream mode & not in broadcast mode */
+    ret = ldrv_dequeue(ch, buffer, sizeof(buffer), LDRV_NOWAIT);
+    KAPI_CHECK(ret == -EAGAIN, "dequeue of empty channel");
+    KAPI_CHECK(ldrv_lost(ch) == 0, "lost bytes of channel without overwrite mode");
+
+    ret = ldrv_enqueue(ch, message, sizeof(message), LDRV_NOWAIT);
+    KAPI_CHECK(ret == sizeof(message), "enqueue");
+
+    ret = ldrv_dequeue(ch, buffer, sizeof(buffer), 0);
+    KAPI_CHECK(ret == sizeof(message) && !memcmp(buffer, message, sizeof(message)), "dequeue");
+
+    /* only multi-producer writers never sleep */
+    ret = ldrv_enqueue(ch, message, sizeof(message), LDRV_ATOMIC);
+    KAPI_CHECK(ret == -EINVAL, "atomic enqueue without multi-producer mode");
+
+    for (i = 0; i < ARRAY_SIZE(parts); i++) {
+        vec[i].iov_base = (void *)parts[i];
+        vec[i].iov_len  = strlen(parts[i]);
+    }
+
+    ret = ldrv_enqueue_batch(ch, vec, ARRAY_SIZE(parts), LDRV_NOWAIT);
+    KAPI_CHECK(ret == ARRAY_SIZE(parts), "enqueue of batch");
+
+    memset(buffer, 0, sizeof(buffer));
+    ret = ldrv_dequeue(ch, buffer, sizeof(buffer), LDRV_NOWAIT);
+    KAPI_CHECK(ret == strlen("kernel batch message") && !strcmp(buffer, "kernel batch message"),
+               "dequeue of batch");
+
+    ldrv_channel_put(ch);
+
+    if (!err)
+        printk(KERN_INFO TEST_NAME ": kernel API test passed\n");
+
+    return err;
+}
+
+static void __exit kapi_test_exit(void)
+{
+}
+
+module_init(kapi_test_init);
+module_exit(kapi_test_exit);
@@ -0,0 +1,7 @@
+#!/bin/sh
+# init of User-Mode Linux booted on the host root file system (hostfs):
+# KUnit suite runs while its module is loaded, results go to the console
+
+mount -t proc proc /proc
+insmod "$ring_test"
+echo o > /proc/sysrq-trigger
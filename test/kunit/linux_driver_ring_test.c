@@ -0,0 +1,642 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* KUNIT TESTS & MICROBENCHMARKS OF RING BUFFER CORE (include/linux_driver_ring.h) */
+
+#include <kunit/test.h>
+#include <linux/completion.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/uio.h>
+
+#include "../../include/linux_driver_ring.h"
+
+#define RING_TEST_MSG       256        /* max message of concurrent producers */
+#define RING_TEST_MSGS      (1 << 17)  /* messages transferred by concurrent producers */
+#define RING_TEST_PRODUCERS 4          /* producers of multi-producer stress */
+#define RING_BENCH_SIZE   (64 << 10) /* ring buffer size of microbenchmarks */
+#define RING_BENCH_BYTES  (64 << 20) /* bytes transferred per message size */
+
+MODULE_LICENSE("GPL");
+MODULE_AUTHOR("Alexander (@alkuzin)");
+MODULE_DESCRIPTION("KUnit suite of linux driver ring buffer core");
+
+/** @brief Concurrent producer state. */
+typedef struct {
+    ring_buffer_t     *rb;
+    spinlock_t        *lock;    /* serializes reservations, NULL - single producer */
+    u32               *reserve; /* reservation index shared by producers */
+    bool              *stop;    /* set by consumer on error */
+    u32               id;
+    u32               total;    /* messages to send */
+    struct completion done;
+} ring_test_producer_t;
+
+static void ring_test_iter(struct iov_iter *iter, struct kvec *vec, u32 dir, void *buf, size_t len)
+{
+    vec->iov_base = buf;
+    vec->iov_len  = len;
+    iov_iter_kvec(iter, dir, vec, 1, len);
+}
+
+static s32 ring_test_alloc(struct kunit *test, u32 size)
+{
+    ring_buffer_t *rb;
+
+    rb = kunit_kzalloc(test, sizeof(ring_buffer_t), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, rb);
+    KUNIT_ASSERT_EQ(test, ring_alloc(rb, size, NUMA_NO_NODE), 0);
+
+    test->priv = rb;
+    return 0;
+}
+
+static s32 ring_test_init(struct kunit *test)
+{
+    return ring_test_alloc(test, PAGE_SIZE);
+}
+
+static s32 ring_bench_init(struct kunit *test)
+{
+    return ring_test_alloc(test, RING_BENCH_SIZE);
+}
+
+static void ring_test_exit(struct kunit *test)
+{
+    ring_destroy(test->priv);
+}
+
+static void ring_test_empty_full(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+
+    KUNIT_EXPECT_EQ(test, rb->ctrl->size, rb->size);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 0U);
+    KUNIT_EXPECT_EQ(test, ring_free(rb), rb->size);
+
+    ring_produce(rb, rb->size - 1);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), rb->size - 1);
+    KUNIT_EXPECT_EQ(test, ring_free(rb), 1U);
+
+    ring_produce(rb, 1);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), rb->size);
+    KUNIT_EXPECT_EQ(test, ring_free(rb), 0U);
+
+    ring_consume(rb, rb->size);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 0U);
+    KUNIT_EXPECT_EQ(test, ring_free(rb), rb->size);
+}
+
+static void ring_test_index_wrap(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+    u8  src[64], dst[64];
+    u32 i;
+
+    for (i = 0; i < sizeof(src); i++)
+        src[i] = i;
+
+    /* free-running indices overflow u32 in the middle of the data */
+    rb->ctrl->head = U32_MAX - 16;
+    rb->ctrl->tail = U32_MAX - 16;
+
+    ring_put(rb, rb->ctrl->head, src, sizeof(src));
+    ring_produce(rb, sizeof(src));
+
+    KUNIT_EXPECT_EQ(test, rb->ctrl->head, (u32)sizeof(src) - 17);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), (u32)sizeof(src));
+    KUNIT_EXPECT_EQ(test, ring_free(rb), rb->size - (u32)sizeof(src));
+
+    ring_get(rb, rb->ctrl->tail, dst, sizeof(dst));
+    ring_consume(rb, sizeof(dst));
+
+    KUNIT_EXPECT_MEMEQ(test, dst, src, sizeof(src));
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 0U);
+}
+
+static void ring_test_mirror(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+    u8  src[32], dst[32];
+    u32 index, i;
+
+    for (i = 0; i < sizeof(src); i++)
+        src[i] = 0xa0 + i;
+
+    /* record crosses the end of the data array, second copy of the pages continues it */
+    index = 5 * rb->size - 10;
+    ring_put(rb, index, src, sizeof(src));
+
+    KUNIT_EXPECT_MEMEQ(test, rb->data + rb->size - 10, src, sizeof(src));
+    KUNIT_EXPECT_MEMEQ(test, rb->data, src + 10, sizeof(src) - 10);
+
+    ring_get(rb, index, dst, sizeof(dst));
+    KUNIT_EXPECT_MEMEQ(test, dst, src, sizeof(src));
+}
+
+static void ring_test_corrupted_indices(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+
+    /* indices written through the shared mapping never report more than size */
+    rb->ctrl->head = 3 * rb->size;
+    rb->ctrl->tail = 0;
+
+    KUNIT_EXPECT_EQ(test, ring_used(rb), rb->size);
+    KUNIT_EXPECT_EQ(test, ring_free(rb), 0U);
+
+    rb->ctrl->head = 0;
+    rb->ctrl->tail = 1;
+
+    KUNIT_EXPECT_EQ(test, ring_used(rb), rb->size);
+    KUNIT_EXPECT_EQ(test, ring_free(rb), 0U);
+}
+
+static void ring_test_partial_transfer(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+    u8  src[100], dst[30];
+    struct iov_iter iter;
+    struct kvec     vec;
+    ssize_t copied;
+    u32 i;
+
+    for (i = 0; i < sizeof(src); i++)
+        src[i] = i;
+
+    /* short write: only free space is taken from the source */
+    ring_test_iter(&iter, &vec, ITER_SOURCE, src, sizeof(src));
+    rb->ctrl->head = rb->ctrl->tail = rb->size - 20;
+
+    copied = ring_write_stream(rb, rb->ctrl->head, 40, &iter);
+    ring_produce(rb, copied);
+
+    KUNIT_EXPECT_EQ(test, copied, 40);
+    KUNIT_EXPECT_EQ(test, (u32)iov_iter_count(&iter), 60U);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 40U);
+
+    /* short read: destination smaller than the data */
+    ring_test_iter(&iter, &vec, ITER_DEST, dst, sizeof(dst));
+
+    copied = ring_read_stream(rb, rb->ctrl->tail, ring_used(rb), &iter);
+    ring_consume(rb, copied);
+
+    KUNIT_EXPECT_EQ(test, copied, (ssize_t)sizeof(dst));
+    KUNIT_EXPECT_MEMEQ(test, dst, src, sizeof(dst));
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 40U - (u32)sizeof(dst));
+
+    /* short read: less data than the destination */
+    ring_test_iter(&iter, &vec, ITER_DEST, dst, sizeof(dst));
+
+    copied = ring_read_stream(rb, rb->ctrl->tail, ring_used(rb), &iter);
+    ring_consume(rb, copied);
+
+    KUNIT_EXPECT_EQ(test, copied, 40 - (ssize_t)sizeof(dst));
+    KUNIT_EXPECT_MEMEQ(test, dst, src + sizeof(dst), 40 - sizeof(dst));
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 0U);
+}
+
+static void ring_test_msg_framing(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+    u8  src[37], dst[64];
+    struct iov_iter iter;
+    struct kvec     vec;
+    ssize_t ret;
+    u32 consumed, head, i;
+
+    for (i = 0; i < sizeof(src); i++)
+        src[i] = 0x40 + i;
+
+    /* header is split by the end of the data array in byte aligned message mode */
+    head           = rb->size - 2;
+    rb->ctrl->head = rb->ctrl->tail = head;
+
+    ring_test_iter(&iter, &vec, ITER_SOURCE, src, sizeof(src));
+    KUNIT_ASSERT_EQ(test, ring_write_msg(rb, head, &iter), (ssize_t)sizeof(src));
+    ring_produce(rb, ring_msg_size(sizeof(src), false));
+
+    KUNIT_EXPECT_EQ(test, ring_used(rb), (u32)(RING_MSG_HDR + sizeof(src)));
+    KUNIT_EXPECT_EQ(test, ring_msg_len(rb, head), (u32)sizeof(src));
+
+    ring_test_iter(&iter, &vec, ITER_DEST, dst, sizeof(dst));
+    ret = ring_read_msg(rb, head, ring_used(rb), ring_msg_len(rb, head), &iter, false, &consumed);
+
+    KUNIT_EXPECT_EQ(test, ret, (ssize_t)sizeof(src));
+    KUNIT_EXPECT_EQ(test, consumed, (u32)(RING_MSG_HDR + sizeof(src)));
+    KUNIT_EXPECT_MEMEQ(test, dst, src, sizeof(src));
+
+    /* multi-producer slots are padded to the header size */
+    KUNIT_EXPECT_EQ(test, ring_msg_size(37, true), (u32)RING_MSG_HDR + 40);
+    KUNIT_EXPECT_EQ(test, ring_msg_size(40, true), (u32)RING_MSG_HDR + 40);
+    KUNIT_EXPECT_EQ(test, ring_msg_size(0, true), (u32)RING_MSG_HDR);
+
+    ring_test_iter(&iter, &vec, ITER_DEST, dst, sizeof(dst));
+    ret = ring_read_msg(rb, head, ring_used(rb), ring_msg_len(rb, head), &iter, true, &consumed);
+
+    KUNIT_EXPECT_EQ(test, ret, (ssize_t)sizeof(src));
+    KUNIT_EXPECT_EQ(test, consumed, ring_msg_size(sizeof(src), true));
+}
+
+static void ring_test_msg_errors(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+    u8  msg[16] = "sixteen bytes..", dst[8];
+    struct iov_iter iter;
+    struct kvec     vec;
+    u32 consumed = 0, used;
+
+    /* message can never fit: write fails with -EMSGSIZE */
+    KUNIT_EXPECT_TRUE(test, ring_msg_fits(rb, rb->size - RING_MSG_HDR));
+    KUNIT_EXPECT_FALSE(test, ring_msg_fits(rb, rb->size - RING_MSG_HDR + 1));
+
+    ring_test_iter(&iter, &vec, ITER_SOURCE, msg, sizeof(msg));
+    KUNIT_ASSERT_EQ(test, ring_write_msg(rb, 0, &iter), (ssize_t)sizeof(msg));
+    ring_produce(rb, ring_msg_size(sizeof(msg), false));
+    used = ring_used(rb);
+
+    /* destination too small: message is kept, nothing is copied */
+    ring_test_iter(&iter, &vec, ITER_DEST, dst, sizeof(dst));
+    KUNIT_EXPECT_EQ(test, ring_read_msg(rb, 0, used, ring_msg_len(rb, 0), &iter, false, &consumed), -EMSGSIZE);
+    KUNIT_EXPECT_EQ(test, (u32)iov_iter_count(&iter), (u32)sizeof(dst));
+    KUNIT_EXPECT_EQ(test, consumed, 0U);
+
+    /* truncated header or length beyond queued data is corrupted */
+    KUNIT_EXPECT_EQ(test, ring_read_msg(rb, 0, RING_MSG_HDR - 1, 0, &iter, false, &consumed), -EIO);
+    KUNIT_EXPECT_EQ(test, ring_read_msg(rb, 0, used, used, &iter, false, &consumed), -EIO);
+    KUNIT_EXPECT_EQ(test, ring_read_msg(rb, 0, used, RING_MSG_BUSY, &iter, false, &consumed), -EIO);
+    KUNIT_EXPECT_EQ(test, consumed, 0U);
+}
+
+static void ring_test_drop(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+    u8  msg[100] = {};
+    struct iov_iter iter;
+    struct kvec     vec;
+    u32 count, need, msgs, i;
+
+    need  = ring_msg_size(sizeof(msg), false);
+    count = rb->size / need;
+
+    for (i = 0; i < count; i++) {
+        ring_test_iter(&iter, &vec, ITER_SOURCE, msg, sizeof(msg));
+        KUNIT_ASSERT_EQ(test, ring_write_msg(rb, rb->ctrl->head, &iter), (ssize_t)sizeof(msg));
+        ring_produce(rb, need);
+    }
+
+    /* enough free space: nothing is dropped */
+    KUNIT_EXPECT_EQ(test, ring_drop(rb, rb->size - count * need, true, &msgs), 0U);
+    KUNIT_EXPECT_EQ(test, msgs, 0U);
+
+    /* whole messages are dropped, even if part of one would do */
+    KUNIT_EXPECT_EQ(test, ring_drop(rb, need, true, &msgs), need);
+    KUNIT_EXPECT_EQ(test, msgs, 1U);
+    KUNIT_EXPECT_EQ(test, rb->ctrl->tail, need);
+
+    KUNIT_EXPECT_EQ(test, ring_drop(rb, 3 * need, true, &msgs), 2 * need);
+    KUNIT_EXPECT_EQ(test, msgs, 2U);
+
+    /* corrupted header drops everything */
+    *ring_hdr(rb, rb->ctrl->tail) = rb->size;
+    KUNIT_EXPECT_EQ(test, ring_drop(rb, rb->size, true, &msgs), (count - 3) * need);
+    KUNIT_EXPECT_EQ(test, msgs, 1U);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 0U);
+
+    /* byte stream drops exactly the missing space */
+    ring_produce(rb, rb->size);
+    KUNIT_EXPECT_EQ(test, ring_drop(rb, 10, false, &msgs), 10U);
+    KUNIT_EXPECT_EQ(test, msgs, 0U);
+    KUNIT_EXPECT_EQ(test, ring_free(rb), 10U);
+}
+
+static void ring_test_reserve_commit(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+    u32 reserve, first, second, index, need, len;
+    u8  dst[16];
+    struct iov_iter iter;
+    struct kvec     vec;
+    u32 consumed;
+
+    /* empty multi-producer ring buffer starts from aligned index */
+    reserve = rb->ctrl->head = rb->ctrl->tail = ALIGN(U32_MAX - 20, RING_MSG_HDR);
+    need    = ring_msg_size(7, true);
+
+    KUNIT_EXPECT_EQ(test, ring_msg_size(6, true), need);
+
+    KUNIT_ASSERT_TRUE(test, ring_reserve(rb, &reserve, need, &first));
+    KUNIT_ASSERT_TRUE(test, ring_reserve(rb, &reserve, need, &second));
+
+    KUNIT_EXPECT_EQ(test, second, first + need);
+    KUNIT_EXPECT_EQ(test, reserve, second + need);
+    KUNIT_EXPECT_EQ(test, *ring_hdr(rb, first), RING_MSG_BUSY);
+    KUNIT_EXPECT_EQ(test, *ring_hdr(rb, second), RING_MSG_BUSY);
+
+    /* later slot is not published before the earlier one */
+    ring_put(rb, second + RING_MSG_HDR, "second", 7);
+    ring_commit(rb, &reserve, second, 7);
+    KUNIT_EXPECT_EQ(test, rb->ctrl->head, first);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 0U);
+
+    /* committing the earlier slot publishes both in reservation order */
+    ring_put(rb, first + RING_MSG_HDR, "first", 6);
+    ring_commit(rb, &reserve, first, 6);
+    KUNIT_EXPECT_EQ(test, rb->ctrl->head, reserve);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 2 * need);
+
+    for (index = first, len = 6; index != reserve; index += consumed, len = 7) {
+        ring_test_iter(&iter, &vec, ITER_DEST, dst, sizeof(dst));
+        KUNIT_EXPECT_EQ(test, ring_read_msg(rb, index, reserve - index, ring_msg_len(rb, index), &iter, true, &consumed),
+                        (ssize_t)len);
+        KUNIT_EXPECT_STREQ(test, (char *)dst, len == 6 ? "first" : "second");
+    }
+
+    ring_consume(rb, 2 * need);
+
+    /* reservation fails without free space */
+    KUNIT_EXPECT_FALSE(test, ring_reserve(rb, &reserve, rb->size + RING_MSG_HDR, &index));
+    KUNIT_ASSERT_TRUE(test, ring_reserve(rb, &reserve, rb->size, &index));
+    KUNIT_EXPECT_FALSE(test, ring_reserve(rb, &reserve, RING_MSG_HDR, &index));
+
+    /* slot of a failed copy is published whole and read as an empty message */
+    ring_commit(rb, &reserve, index, RING_MSG_SKIP | (rb->size - RING_MSG_HDR));
+    KUNIT_EXPECT_EQ(test, rb->ctrl->head, reserve);
+
+    ring_test_iter(&iter, &vec, ITER_DEST, dst, sizeof(dst));
+    KUNIT_EXPECT_EQ(test, ring_read_msg(rb, index, ring_used(rb), ring_msg_len(rb, index), &iter, true, &consumed), 0);
+    KUNIT_EXPECT_EQ(test, consumed, rb->size);
+    KUNIT_EXPECT_EQ(test, (u32)iov_iter_count(&iter), (u32)sizeof(dst));
+}
+
+static void ring_test_fill(u8 *msg, u32 len, u32 id, u32 seq)
+{
+    u32 i;
+
+    memcpy(msg, &id, sizeof(u32));
+    memcpy(msg + sizeof(u32), &seq, sizeof(u32));
+
+    for (i = 2 * sizeof(u32); i < len; i++)
+        msg[i] = (u8)(seq + i);
+}
+
+static s32 ring_test_producer(void *arg)
+{
+    ring_test_producer_t *p = arg;
+    ring_buffer_t *rb = p->rb;
+    u8  msg[RING_TEST_MSG];
+    struct iov_iter iter;
+    struct kvec     vec;
+    u32 seq, seed = p->id + 1, len, index;
+    bool reserved;
+
+    for (seq = 0; seq < p->total && !READ_ONCE(*p->stop); seq++) {
+        /* messages of pseudo-random length exercise every offset of the data array */
+        seed = seed * 1103515245 + 12345;
+        len  = 2 * sizeof(u32) + (seed >> 16) % (RING_TEST_MSG - 2 * sizeof(u32) + 1);
+
+        ring_test_fill(msg, len, p->id, seq);
+        ring_test_iter(&iter, &vec, ITER_SOURCE, msg, len);
+
+        if (!p->lock) {
+            while (ring_free(rb) < ring_msg_size(len, false) && !READ_ONCE(*p->stop))
+                cond_resched();
+
+            if (READ_ONCE(*p->stop) || ring_write_msg(rb, READ_ONCE(rb->ctrl->head), &iter) != len)
+                break;
+
+            ring_produce(rb, ring_msg_size(len, false));
+            continue;
+        }
+
+        /* concurrent producers serialize only reservations */
+        for (;;) {
+            spin_lock(p->lock);
+            reserved = ring_reserve(rb, p->reserve, ring_msg_size(len, true), &index);
+            spin_unlock(p->lock);
+
+            if (reserved || READ_ONCE(*p->stop))
+                break;
+
+            cond_resched();
+        }
+
+        if (!reserved)
+            break;
+
+        ring_commit(rb, p->reserve, index,
+                    ring_copy_from_iter(rb, index + RING_MSG_HDR, &iter, len) == len ? len : RING_MSG_SKIP | len);
+    }
+
+    complete(&p->done);
+    return 0;
+}
+
+static void ring_test_stress(struct kunit *test, u32 producers, u32 total)
+{
+    ring_buffer_t *rb = test->priv;
+    ring_test_producer_t *p;
+    struct task_struct *task;
+    struct iov_iter iter;
+    struct kvec     vec;
+    spinlock_t      lock;
+    u32 *expected, reserve = 0, received = 0, errors = 0;
+    u32 used, consumed, tail, id, seq, started;
+    u8  msg[RING_TEST_MSG], ref[RING_TEST_MSG];
+    u64 start, duration, bytes = 0;
+    bool stop = false;
+    ssize_t len;
+
+    p        = kunit_kcalloc(test, producers, sizeof(*p), GFP_KERNEL);
+    expected = kunit_kcalloc(test, producers, sizeof(u32), GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, p);
+    KUNIT_ASSERT_NOT_NULL(test, expected);
+
+    spin_lock_init(&lock);
+    start = ktime_get_ns();
+
+    for (started = 0; started < producers; started++) {
+        p[started].rb      = rb;
+        p[started].lock    = producers > 1 ? &lock : NULL;
+        p[started].reserve = &reserve;
+        p[started].stop    = &stop;
+        p[started].id      = started;
+        p[started].total   = total;
+        init_completion(&p[started].done);
+
+        task = kthread_run(ring_test_producer, &p[started], "ring_test_producer/%u", started);
+
+        if (IS_ERR(task)) {
+            KUNIT_FAIL(test, "failed to start producer %u: %ld", started, PTR_ERR(task));
+            WRITE_ONCE(stop, true);
+            break;
+        }
+    }
+
+    /* on error producers are stopped, as they refer to the state of this function */
+    while (!stop && received < producers * total) {
+        while (!(used = ring_used(rb)))
+            cond_resched();
+
+        ring_test_iter(&iter, &vec, ITER_DEST, msg, sizeof(msg));
+        tail = READ_ONCE(rb->ctrl->tail);
+        len  = ring_read_msg(rb, tail, used, ring_msg_len(rb, tail), &iter, producers > 1, &consumed);
+
+        if (len < (ssize_t)(2 * sizeof(u32))) {
+            KUNIT_FAIL(test, "message %u: read returned %zd", received, len);
+            WRITE_ONCE(stop, true);
+            break;
+        }
+
+        ring_consume(rb, consumed);
+
+        /* messages of each producer arrive complete & in order */
+        memcpy(&id, msg, sizeof(u32));
+        memcpy(&seq, msg + sizeof(u32), sizeof(u32));
+
+        if (id >= producers || seq != expected[id]) {
+            errors++;
+        }
+        else {
+            ring_test_fill(ref, len, id, seq);
+            errors += memcmp(msg, ref, len) != 0;
+            expected[id]++;
+        }
+
+        bytes += len;
+        received++;
+    }
+
+    while (started--)
+        wait_for_completion(&p[started].done);
+
+    duration = ktime_get_ns() - start;
+
+    KUNIT_EXPECT_EQ(test, errors, 0U);
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 0U);
+    kunit_info(test, "%u producers, %u messages, %llu bytes in %llu us, %llu MB/s\n", producers, received, bytes,
+               div_u64(duration, NSEC_PER_USEC), div64_u64(bytes * NSEC_PER_USEC, duration ?: 1));
+}
+
+static void ring_test_spsc_stress(struct kunit *test)
+{
+    ring_test_stress(test, 1, RING_TEST_MSGS);
+}
+
+static void ring_test_mp_stress(struct kunit *test)
+{
+    ring_test_stress(test, RING_TEST_PRODUCERS, RING_TEST_MSGS / RING_TEST_PRODUCERS);
+}
+
+static const u32 ring_bench_sizes[] = {8, 64, 256, 1024, 4096, 16384};
+
+static void ring_bench_desc(const u32 *size, char *desc)
+{
+    snprintf(desc, KUNIT_PARAM_DESC_SIZE, "%u bytes", *size);
+}
+
+KUNIT_ARRAY_PARAM(ring_bench, ring_bench_sizes, ring_bench_desc);
+
+static void ring_bench_enqueue_dequeue(struct kunit *test)
+{
+    ring_buffer_t *rb = test->priv;
+    u32 size = *(const u32 *)test->param_value;
+    u64 enqueue = 0, dequeue = 0, start, msgs, done;
+    u32 batch, need, consumed = 0, tail, i;
+    struct iov_iter iter;
+    struct kvec     vec;
+    u8  *msg;
+
+    msg = kunit_kzalloc(test, size, GFP_KERNEL);
+    KUNIT_ASSERT_NOT_NULL(test, msg);
+
+    need  = ring_msg_size(size, false);
+    msgs  = RING_BENCH_BYTES / size;
+    batch = rb->size / need;
+
+    /* ring buffer is filled & drained in turns, so both sides hit full & empty states */
+    for (done = 0; done < msgs; done += batch) {
+        start = ktime_get_ns();
+
+        for (i = 0; i < batch && ring_free(rb) >= need; i++) {
+            ring_test_iter(&iter, &vec, ITER_SOURCE, msg, size);
+            ring_write_msg(rb, READ_ONCE(rb->ctrl->head), &iter);
+            ring_produce(rb, need);
+        }
+
+        enqueue += ktime_get_ns() - start;
+        start    = ktime_get_ns();
+
+        for (i = 0; i < batch && ring_used(rb) >= need; i++) {
+            ring_test_iter(&iter, &vec, ITER_DEST, msg, size);
+            tail = READ_ONCE(rb->ctrl->tail);
+            ring_read_msg(rb, tail, ring_used(rb), ring_msg_len(rb, tail), &iter, false, &consumed);
+            ring_consume(rb, consumed);
+        }
+
+        dequeue += ktime_get_ns() - start;
+        cond_resched();
+    }
+
+    KUNIT_EXPECT_EQ(test, ring_used(rb), 0U);
+
+    /* bytes per nanosecond * 1000 = MB/s */
+    kunit_info(test, "%5u bytes: enqueue %llu ns/msg %llu MB/s, dequeue %llu ns/msg %llu MB/s\n", size,
+               div64_u64(enqueue, done), div64_u64(done * size * 1000, enqueue ?: 1),
+               div64_u64(dequeue, done), div64_u64(done * size * 1000, dequeue ?: 1));
+}
+
+static struct kunit_case ring_test_cases[] = {
+    KUNIT_CASE(ring_test_empty_full),
+    KUNIT_CASE(ring_test_index_wrap),
+    KUNIT_CASE(ring_test_mirror),
+    KUNIT_CASE(ring_test_corrupted_indices),
+    KUNIT_CASE(ring_test_partial_transfer),
+    KUNIT_CASE(ring_test_overwrite),
+    KUNIT_CASE(ring_test_msg_framing),
+    KUNIT_CASE(ring_test_msg_errors),
+    KUNIT_CASE(ring_test_drop),
+    KUNIT_CASE(ring_test_reserve_commit),
+    KUNIT_CASE(ring_test_spsc_stress),
+    KUNIT_CASE(ring_test_mp_stress),
+    {}
+};
+
+static struct kunit_case ring_bench_cases[] = {
+    KUNIT_CASE_PARAM(ring_bench_enqueue_dequeue, ring_bench_gen_params),
+    {}
+};
+
+static struct kunit_suite ring_test_suite = {
+    .name       = "linux_driver_ring",
+    .init       = ring_test_init,
+    .exit       = ring_test_exit,
+    .test_cases = ring_test_cases,
+};
+
+static struct kunit_suite ring_bench_suite = {
+    .name       = "linux_driver_ring_bench",
+    .init       = ring_bench_init,
+    .exit       = ring_test_exit,
+    .test_cases = ring_bench_cases,
+};
+
+kunit_test_suites(&ring_test_suite, &ring_bench_suite);
@@ -24,14 +24,59 @@
 #include <fcntl.h>
 #include <time.h>
 
-#define DEVICE_NAME "/dev/test_task_dev"
+#define DEVICE_NAME "/dev/test_task_dev0"
+#define SYSFS_DIR   "/sys/class/test_task_dev_class/test_task_dev0/"
 #define BUFFER_SIZE 20
 
 #define IOCTL_BLOCK          0
 #define IOCTL_NONBLOCK       1
 #define IOCTL_BUFINFO        _IOR('k', 2, dev_buf_info_t)
+#define IOCTL_WAIT_READ      _IO('k', 3)
+#define IOCTL_WAIT_WRITE     _IO('k', 4)
+#define IOCTL_WAKE           _IO('k', 5)
+#define IOCTL_MSG_MODE       _IO('k', 6)
+#define IOCTL_SEND_BATCH     _IOW('k', 7, dev_msg_batch_t)
+#define IOCTL_RECV_BATCH     _IOWR('k', 8, dev_msg_batch_t)
 #define IOCTL_INCORRECT_MODE 99
 
+#define URING_CMD_ENQUEUE    _IOW('k', 9, dev_uring_cmd_t)
+#define URING_CMD_DEQUEUE    _IOW('k', 10, dev_uring_cmd_t)
+#define URING_CMD_WAIT_READ  _IOW('k', 11, dev_uring_cmd_t)
+#define URING_CMD_WAIT_WRITE _IOW('k', 12, dev_uring_cmd_t)
+
+#define IOCTL_LAT_HIST       _IOWR('k', 13, dev_lat_hist_t)
+#define IOCTL_LAT_RESET      _IO('k', 14)
+#define IOCTL_RESIZE         _IO('k', 15)
+#define IOCTL_READ_TIMEOUT   _IO('k', 16)
+#define IOCTL_WRITE_TIMEOUT  _IO('k', 17)
+#define IOCTL_BUSY_POLL      _IO('k', 18)
+#define IOCTL_LOWAT          _IOW('k', 19, dev_lowat_t)
+#define IOCTL_FLUSH          _IO('k', 20)
+#define IOCTL_BROADCAST      _IO('k', 21)
+#define IOCTL_SUBSCRIBE      _IO('k', 22)
+#define IOCTL_LOST           _IOR('k', 23, unsigned long long)
+#define IOCTL_OVERWRITE      _IO('k', 24)
+#define IOCTL_MP_MODE        _IO('k', 25)
+#define IOCTL_LANES          _IOW('k', 26, dev_lanes_t)
+#define IOCTL_LANE           _IO('k', 27)
+#define IOCTL_NUMA_NODE      _IO('k', 28)
+
+#define RING_NODE_READER (-2)
+
+#define BCAST_OFF     0
+#define BCAST_BLOCK   1
+#define BCAST_OVERRUN 2
+
+#define LANES_MAX 4
+
+#define RING_CTRL_ALIGN 128
+#define MAX_BATCH       1024
+
+#define LAT_BUCKETS    160
+#define LAT_READ_WAIT  0
+#define LAT_WRITE_WAIT 1
+#define LAT_RESIDENCE  2
+
 /**
  * @brief Device buffer information structure.
  * 
@@ -48,6 +93,62 @@ typedef struct {
     uid_t  last_write_owner;
 } dev_buf_info_t;
 
+/** @brief Message descriptor structure (see include/linux_driver.h). */
+typedef struct {
+    unsigned long long buf;
+    unsigned int       len;
+    unsigned int       pad;
+} dev_msg_t;
+
+/** @brief io_uring command payload structure (see include/linux_driver.h). */
+typedef struct {
+    unsigned long long buf;
+    unsigned int       len;
+    unsigned int       pad;
+} dev_uring_cmd_t;
+
+/** @brief Messages batch structure (see include/linux_driver.h). */
+typedef struct {
+    unsigned long long msgs;
+    unsigned int       count;
+    unsigned int       pad;
+} dev_msg_batch_t;
+
+/** @brief Wake up watermarks structure (see include/linux_driver.h). */
+typedef struct {
+    unsigned int read_lowat;
+    unsigned int write_lowat;
+    unsigned int flush_delay;
+    unsigned int read_lowat_msgs;
+} dev_lowat_t;
+
+/** @brief Priority lanes structure (see include/linux_driver.h). */
+typedef struct {
+    unsigned int lanes;
+    unsigned int weights[LANES_MAX];
+} dev_lanes_t;
+
+/** @brief Latency histogram structure (see include/linux_driver.h). */
+typedef struct {
+    unsigned int       type;
+    unsigned int       pad;
+    unsigned long long counts[LAT_BUCKETS];
+} dev_lat_hist_t;
+
+/**
+ * @brief Ring buffer control structure.
+ * 
+ * First page of the device mapping, ring buffer data starts
+ * at the next page. See include/linux_driver.h for details.
+ */
+typedef struct {
+    unsigned int size;
+    unsigned int head          __attribute__((aligned(RING_CTRL_ALIGN)));
+    int          write_waiters;
+    unsigned int tail          __attribute__((aligned(RING_CTRL_ALIGN)));
+    int          read_waiters;
+} ring_ctrl_t;
+
 /**
  * @brief Set ioctl mode.
  * 
@@ -74,4 +175,12 @@ void display_buf_info(dev_buf_info_t info);
  */
 void display_time(const char *descr, time_t raw_time);
 
+/**
+ * @brief Read numeric attribute of the channel.
+ * 
+ * @param [in] name - given attribute path relative to SYSFS_DIR.
+ * @return attribute value.
+ */
+long long read_attr(const char *name);
+
 #endif /* _TEST_TASK_LINUX_DRIVER_TEST_H_ */ 
\ No newline at end of file
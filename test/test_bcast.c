@@ -0,0 +1,188 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST BROADCAST MODE (fan-out, slowest reader & overrun) */
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "test.h"
+
+#define READERS 3
+
+/**
+ * @brief Open device file in non-blocking mode.
+ *
+ * @return device file descriptor.
+ */
+static int open_dev(void)
+{
+    int fd = open(DEVICE_NAME, O_RDWR | O_NONBLOCK);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Set broadcast mode.
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] mode - given broadcast mode (BCAST_*).
+ */
+static void set_bcast(int fd, int mode)
+{
+    if (ioctl(fd, IOCTL_BROADCAST, mode) < 0) {
+        perror("set broadcast mode error");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Check result of read() or write().
+ *
+ * @param [in] ret - given result.
+ * @param [in] expected - given expected result.
+ * @param [in] err - given expected errno if expected result is -1.
+ * @param [in] descr - given description of the operation.
+ */
+static void check(ssize_t ret, ssize_t expected, int err, const char *descr)
+{
+    if (ret != expected || (ret == -1 && errno != err)) {
+        printf("bcast: %s returned %zd instead of %zd\n", descr, ret, expected);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void)
+{
+    const char *message = "fan-out";
+    ssize_t len = strlen(message);
+    int  readers[READERS];
+    unsigned long long lost;
+    struct pollfd pfd;
+    char *data, *buffer;
+    int  writer, size, i;
+
+    writer = open_dev();
+    size   = read_attr("size");
+    data   = malloc(size);
+    buffer = malloc(size);
+
+    if (!data || !buffer) {
+        perror("malloc error");
+        exit(EXIT_FAILURE);
+    }
+
+    memset(data, 'x', size);
+
+    if (ioctl(writer, IOCTL_BROADCAST, BCAST_OVERRUN + 1) != -1 || errno != EINVAL) {
+        puts("bcast: incorrect broadcast mode accepted");
+        exit(EXIT_FAILURE);
+    }
+
+    set_bcast(writer, BCAST_BLOCK);
+
+    for (i = 0; i < READERS; i++)
+        readers[i] = open_dev();
+
+    /* poll() does not subscribe, so the last reader does not get data */
+    for (i = 0; i < READERS - 1; i++) {
+        if (ioctl(readers[i], IOCTL_SUBSCRIBE) < 0) {
+            perror("subscribe error");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pfd.fd     = readers[READERS - 1];
+    pfd.events = POLLIN;
+
+    check(poll(&pfd, 1, 0), 0, 0, "poll of unsubscribed reader");
+    check(write(writer, message, len), len, 0, "write");
+    check(poll(&pfd, 1, 0), 0, 0, "poll of unsubscribed reader");
+
+    /* every subscribed reader gets all data */
+    for (i = 0; i < READERS - 1; i++) {
+        memset(buffer, 0, size);
+        check(read(readers[i], buffer, size), len, 0, "read of subscribed reader");
+
+        if (memcmp(buffer, message, len) != 0) {
+            printf("bcast: reader %d got incorrect data\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* the first read subscribes to data written from now on */
+    check(read(readers[READERS - 1], buffer, size), -1, EAGAIN, "first read of polling reader");
+    close(readers[READERS - 1]);
+
+    puts("bcast: data fanned out to subscribed readers only");
+
+    /* writer waits for the slowest reader */
+    check(write(writer, data, size), size, 0, "write of full ring buffer");
+    check(read(readers[0], buffer, size), size, 0, "read of fast reader");
+    check(write(writer, data, 1), -1, EAGAIN, "write before slow reader read");
+    check(read(readers[1], buffer, size), size, 0, "read of slow reader");
+    check(write(writer, data, 1), 1, 0, "write after slow reader read");
+
+    for (i = 0; i < READERS - 1; i++)
+        check(read(readers[i], buffer, size), 1, 0, "read");
+
+    puts("bcast: writer waited for the slowest reader");
+
+    close(readers[1]);
+
+    /* writer overwrites unread data of the overrun reader */
+    set_bcast(writer, BCAST_OVERRUN);
+
+    check(write(writer, data, size), size, 0, "write of full ring buffer");
+    check(write(writer, data, 16), 16, 0, "write to full ring buffer");
+    check(read(readers[0], buffer, size), -1, EOVERFLOW, "read of overrun reader");
+
+    if (ioctl(readers[0], IOCTL_LOST, &lost) < 0) {
+        perror("get lost bytes error");
+        exit(EXIT_FAILURE);
+    }
+
+    if (lost != (unsigned long long)size + 16) {
+        printf("bcast: reader lost %llu bytes instead of %d\n", lost, size + 16);
+        exit(EXIT_FAILURE);
+    }
+
+    /* overrun reader continues from the newest data */
+    check(read(readers[0], buffer, size), -1, EAGAIN, "read after overrun");
+    check(write(writer, message, len), len, 0, "write");
+    memset(buffer, 0, size);
+    check(read(readers[0], buffer, size), len, 0, "read after overrun");
+
+    if (memcmp(buffer, message, len) != 0) {
+        puts("bcast: overrun reader got incorrect data");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("bcast: overrun reader lost %llu bytes & continued\n", lost);
+
+    close(readers[0]);
+    set_bcast(writer, BCAST_OFF);
+    close(writer);
+    free(data);
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,717 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* BENCHMARK (device against pipe, UNIX socket & shared memory) */
+
+#define _GNU_SOURCE
+
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <limits.h>
+#include <string.h>
+#include <sched.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define MAX_THREADS  64
+#define MAX_CPUS     256
+#define MIN_MSG_SIZE sizeof(unsigned long long) /* message starts with send timestamp */
+#define CACHE_LINE   64
+
+/* benchmarked transports */
+#define T_DEV   0
+#define T_PIPE  1
+#define T_UNIX  2
+#define T_SHM   3
+#define T_COUNT 4
+
+/* output formats */
+#define F_TEXT 0
+#define F_CSV  1
+#define F_JSON 2
+
+static const char *transport_names[T_COUNT] = {"dev", "pipe", "unix", "shm"};
+
+/** @brief Benchmark options structure. */
+typedef struct {
+    unsigned int size;      /* message size in bytes */
+    unsigned int messages;  /* total number of messages */
+    unsigned int depth;     /* transport capacity in messages */
+    unsigned int producers;
+    unsigned int consumers;
+    unsigned int cpus[MAX_CPUS];
+    unsigned int ncpus;     /* threads are pinned round-robin, 0 - not pinned */
+    int          nonblock;  /* O_NONBLOCK & spin on EAGAIN instead of sleeping */
+    int          format;
+    int          transports[T_COUNT];
+} bench_opts_t;
+
+/** @brief Shared memory queue slot sequence (bounded MPMC queue). */
+typedef struct {
+    unsigned long long seq;
+    char               pad[CACHE_LINE - sizeof(unsigned long long)];
+} shm_slot_t;
+
+/** @brief Shared memory queue structure, baseline without system calls. */
+typedef struct {
+    unsigned long long head __attribute__((aligned(CACHE_LINE)));
+    unsigned long long tail __attribute__((aligned(CACHE_LINE)));
+    unsigned long long mask __attribute__((aligned(CACHE_LINE)));
+    shm_slot_t         *slots;
+    char               *data;
+    size_t             length; /* mapping length */
+} shm_queue_t;
+
+/** @brief Benchmark thread structure. */
+typedef struct {
+    const bench_opts_t *opts;
+    pthread_barrier_t  *barrier;
+    shm_queue_t        *queue;
+    int                transport;
+    int                fd;
+    unsigned int       cpu;
+    int                pinned;
+    unsigned int       count;   /* number of messages to send or receive */
+    unsigned long long *samples; /* latencies of received messages */
+} bench_thread_t;
+
+/** @brief Benchmark result structure. */
+typedef struct {
+    double             seconds;
+    unsigned long long p50, p90, p99, p999, max;
+} bench_result_t;
+
+/** @brief Print usage & exit. */
+static void usage(const char *name);
+
+/**
+ * @brief Parse command line options.
+ *
+ * @param [in] argc - given number of arguments.
+ * @param [in] argv - given arguments.
+ * @param [out] opts - given options structure.
+ */
+static void parse_opts(int argc, char **argv, bench_opts_t *opts);
+
+/** @brief Get monotonic time in nanoseconds. */
+static unsigned long long now_ns(void);
+
+/**
+ * @brief Run benchmark of one transport.
+ *
+ * @param [in] opts - given benchmark options.
+ * @param [in] transport - given transport (T_*).
+ * @param [out] result - given structure to store results.
+ * @return 0 - in case of success.
+ * @return -1 - in case of error.
+ */
+static int run(const bench_opts_t *opts, int transport, bench_result_t *result);
+
+/** @brief Producer thread routine. */
+static void *producer(void *arg);
+
+/** @brief Consumer thread routine. */
+static void *consumer(void *arg);
+
+/**
+ * @brief Send or receive one message through file descriptor of the thread.
+ *
+ * Pipe is a byte stream, so short transfers are continued,
+ * other transports transfer a message at once. Spins on EAGAIN.
+ *
+ * @param [in] th - given benchmark thread.
+ * @param [in,out] msg - given message buffer.
+ * @param [in] send - given 1 to write or 0 to read.
+ * @return 0 - in case of success.
+ * @return -1 - in case of error or end of file.
+ */
+static int transfer(bench_thread_t *th, char *msg, int send);
+
+/**
+ * @brief Allocate shared memory queue.
+ *
+ * @param [in] depth - given capacity in messages (rounded up to a power of two).
+ * @param [in] size - given message size.
+ * @return queue - in case of success.
+ * @return NULL - in case of error.
+ */
+static shm_queue_t *shm_create(unsigned int depth, unsigned int size);
+
+/** @brief Push message into shared memory queue, spins while the queue is full. */
+static void shm_push(shm_queue_t *queue, const char *msg, unsigned int size);
+
+/** @brief Pop message from shared memory queue, spins while the queue is empty. */
+static void shm_pop(shm_queue_t *queue, char *msg, unsigned int size);
+
+/** @brief Print result in the selected format. */
+static void report(const bench_opts_t *opts, int transport, const bench_result_t *result);
+
+
+int main(int argc, char **argv)
+{
+    bench_result_t result;
+    bench_opts_t   opts;
+    int            t, ret = 0;
+
+    parse_opts(argc, argv, &opts);
+
+    if (opts.format == F_CSV)
+        puts("transport,size,messages,depth,producers,consumers,mode,seconds,"
+             "msgs_per_sec,gb_per_sec,p50_ns,p90_ns,p99_ns,p999_ns,max_ns");
+    else if (opts.format == F_TEXT)
+        printf("%-5s %8s %9s %13s %9s %9s %9s %9s %9s\n", "name", "size", "seconds",
+               "msg/s", "GB/s", "p50 ns", "p99 ns", "p99.9 ns", "max ns");
+
+    for (t = 0; t < T_COUNT; t++) {
+        if (!opts.transports[t])
+            continue;
+
+        if (run(&opts, t, &result) < 0) {
+            fprintf(stderr, "bench: %s: failed\n", transport_names[t]);
+            ret = 1;
+            continue;
+        }
+
+        report(&opts, t, &result);
+    }
+
+    return ret;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-t dev,pipe,unix,shm] [-s size] [-n messages] [-d depth]\n"
+            "       [-p producers] [-c consumers] [-a cpu,cpu,...] [-b] [-o text|csv|json]\n"
+            "  -b  non-blocking mode (spin on EAGAIN)\n", name);
+    exit(EXIT_FAILURE);
+}
+
+static void parse_opts(int argc, char **argv, bench_opts_t *opts)
+{
+    char *token;
+    int  opt, t;
+
+    memset(opts, 0, sizeof(bench_opts_t));
+
+    opts->size      = 64;
+    opts->messages  = 1000000;
+    opts->depth     = 256;
+    opts->producers = 1;
+    opts->consumers = 1;
+
+    while ((opt = getopt(argc, argv, "t:s:n:d:p:c:a:bo:")) != -1) {
+        switch (opt) {
+            case 't':
+                for (token = strtok(optarg, ","); token; token = strtok(NULL, ",")) {
+                    for (t = 0; t < T_COUNT && strcmp(token, transport_names[t]); t++);
+
+                    if (t == T_COUNT)
+                        usage(argv[0]);
+
+                    opts->transports[t] = 1;
+                }
+                break;
+
+            case 's':
+                opts->size = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'n':
+                opts->messages = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'd':
+                opts->depth = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'p':
+                opts->producers = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'c':
+                opts->consumers = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'a':
+                for (token = strtok(optarg, ","); token && opts->ncpus < MAX_CPUS; token = strtok(NULL, ","))
+                    opts->cpus[opts->ncpus++] = strtoul(token, NULL, 0);
+                break;
+
+            case 'b':
+                opts->nonblock = 1;
+                break;
+
+            case 'o':
+                if (!strcmp(optarg, "csv"))
+                    opts->format = F_CSV;
+                else if (!strcmp(optarg, "json"))
+                    opts->format = F_JSON;
+                else if (!strcmp(optarg, "text"))
+                    opts->format = F_TEXT;
+                else
+                    usage(argv[0]);
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+
+    /* all transports by default */
+    for (t = 0; t < T_COUNT && !opts->transports[t]; t++);
+
+    if (t == T_COUNT) {
+        for (t = 0; t < T_COUNT; t++)
+            opts->transports[t] = 1;
+    }
+
+    if (opts->size < MIN_MSG_SIZE || !opts->messages || !opts->depth ||
+        !opts->producers || !opts->consumers ||
+        opts->producers + opts->consumers > MAX_THREADS)
+        usage(argv[0]);
+}
+
+static unsigned long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int open_transport(const bench_opts_t *opts, int transport, int fds[2])
+{
+    unsigned int bytes = opts->depth * opts->size;
+    int sndbuf = bytes;
+
+    switch (transport) {
+        case T_DEV:
+            fds[0] = open(DEVICE_NAME, O_RDWR);
+
+            if (fds[0] == -1) {
+                perror("Error opening " DEVICE_NAME);
+                return -1;
+            }
+
+            fds[1] = fds[0];
+
+            /* message mode keeps messages whole with several consumers */
+            if (ioctl(fds[0], IOCTL_MSG_MODE, 1) < 0) {
+                perror("bench: dev: set message mode error");
+                close(fds[0]);
+                return -1;
+            }
+
+            if (ioctl(fds[0], IOCTL_RESIZE, opts->depth * (opts->size + sizeof(unsigned int))) < 0)
+                perror("bench: dev: resize error (size is left unchanged)");
+
+            /* producers reserve slots concurrently instead of taking the write lock */
+            if (opts->producers > 1 && ioctl(fds[0], IOCTL_MP_MODE, 1) < 0)
+                perror("bench: dev: multi-producer mode error (writes are serialized)");
+
+            break;
+
+        case T_PIPE:
+            /* writes up to PIPE_BUF are atomic, larger ones may interleave */
+            if (opts->size > PIPE_BUF && (opts->producers > 1 || opts->consumers > 1)) {
+                fprintf(stderr, "bench: pipe: messages larger than %d bytes need 1 producer & 1 consumer\n", PIPE_BUF);
+                return -1;
+            }
+
+            if (pipe(fds) < 0) {
+                perror("bench: pipe error");
+                return -1;
+            }
+
+            /* best effort, the kernel rounds capacity up & may limit it */
+            fcntl(fds[1], F_SETPIPE_SZ, bytes);
+            break;
+
+        case T_UNIX:
+            /* SOCK_SEQPACKET keeps message boundaries */
+            if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) < 0) {
+                perror("bench: socketpair error");
+                return -1;
+            }
+
+            setsockopt(fds[1], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+            break;
+
+        default:
+            fds[0] = fds[1] = -1;
+            return 0;
+    }
+
+    if (opts->nonblock) {
+        fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    }
+
+    return 0;
+}
+
+static void close_transport(int transport, int fds[2])
+{
+    switch (transport) {
+        case T_DEV:
+            ioctl(fds[0], IOCTL_MP_MODE, 0);
+            ioctl(fds[0], IOCTL_MSG_MODE, 0);
+            close(fds[0]);
+            break;
+
+        case T_PIPE:
+        case T_UNIX:
+            close(fds[0]);
+            close(fds[1]);
+            break;
+
+        default:
+            break;
+    }
+}
+
+static int run(const bench_opts_t *opts, int transport, bench_result_t *result)
+{
+    bench_thread_t     threads[MAX_THREADS];
+    pthread_t          tids[MAX_THREADS];
+    pthread_barrier_t  barrier;
+    shm_queue_t        *queue = NULL;
+    unsigned long long start, *samples = NULL, total;
+    unsigned int       nthreads, i, n;
+    int                fds[2], ret = -1;
+
+    if (open_transport(opts, transport, fds) < 0)
+        return -1;
+
+    if (transport == T_SHM && !(queue = shm_create(opts->depth, opts->size)))
+        goto out;
+
+    samples = malloc(opts->messages * sizeof(unsigned long long));
+
+    if (!samples) {
+        perror("bench: memory allocation error");
+        goto out;
+    }
+
+    nthreads = opts->producers + opts->consumers;
+    pthread_barrier_init(&barrier, NULL, nthreads + 1);
+
+    /* producers first, messages are distributed evenly */
+    for (i = 0, total = 0; i < nthreads; i++) {
+        bench_thread_t *th = &threads[i];
+        int is_producer = i < opts->producers;
+
+        n = is_producer ? opts->producers : opts->consumers;
+
+        th->opts      = opts;
+        th->barrier   = &barrier;
+        th->queue     = queue;
+        th->transport = transport;
+        th->fd        = is_producer ? fds[1] : fds[0];
+        th->pinned    = opts->ncpus != 0;
+        th->cpu       = opts->ncpus ? opts->cpus[i % opts->ncpus] : 0;
+        th->count     = opts->messages / n + ((is_producer ? i : i - opts->producers) < opts->messages % n);
+        th->samples   = NULL;
+
+        if (!is_producer) {
+            th->samples = samples + total;
+            total      += th->count;
+        }
+
+        /* started threads wait on the barrier, so there is no way back */
+        if (pthread_create(&tids[i], NULL, is_producer ? producer : consumer, th)) {
+            fprintf(stderr, "bench: failed to create thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+    start = now_ns();
+
+    for (i = 0; i < nthreads; i++)
+        pthread_join(tids[i], NULL);
+
+    result->seconds = (now_ns() - start) / 1e9;
+
+    qsort(samples, opts->messages, sizeof(unsigned long long), compare_u64);
+
+    result->p50  = samples[(unsigned long long)opts->messages * 500 / 1000];
+    result->p90  = samples[(unsigned long long)opts->messages * 900 / 1000];
+    result->p99  = samples[(unsigned long long)opts->messages * 990 / 1000];
+    result->p999 = samples[(unsigned long long)opts->messages * 999 / 1000];
+    result->max  = samples[opts->messages - 1];
+
+    pthread_barrier_destroy(&barrier);
+    ret = 0;
+
+out:
+    close_transport(transport, fds);
+    free(samples);
+
+    if (queue) {
+        munmap(queue->slots, queue->length);
+        free(queue);
+    }
+
+    return ret;
+}
+
+static void pin(bench_thread_t *th)
+{
+    cpu_set_t set;
+
+    if (!th->pinned)
+        return;
+
+    CPU_ZERO(&set);
+    CPU_SET(th->cpu, &set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        fprintf(stderr, "bench: failed to pin thread to CPU %u\n", th->cpu);
+}
+
+static void *producer(void *arg)
+{
+    bench_thread_t *th = arg;
+    unsigned int   size = th->opts->size, i;
+    unsigned long long stamp;
+    char           *msg;
+
+    if (!(msg = calloc(1, size))) {
+        perror("bench: memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    pin(th);
+    pthread_barrier_wait(th->barrier);
+
+    for (i = 0; i < th->count; i++) {
+        stamp = now_ns();
+        memcpy(msg, &stamp, sizeof(stamp));
+
+        if (th->transport == T_SHM) {
+            shm_push(th->queue, msg, size);
+            continue;
+        }
+
+        if (transfer(th, msg, 1) < 0) {
+            perror("bench: write error");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    free(msg);
+    return NULL;
+}
+
+static void *consumer(void *arg)
+{
+    bench_thread_t *th = arg;
+    unsigned int   size = th->opts->size, i;
+    unsigned long long stamp;
+    char           *msg;
+
+    if (!(msg = calloc(1, size))) {
+        perror("bench: memory allocation error");
+        exit(EXIT_FAILURE);
+    }
+
+    pin(th);
+    pthread_barrier_wait(th->barrier);
+
+    for (i = 0; i < th->count; i++) {
+        if (th->transport == T_SHM)
+            shm_pop(th->queue, msg, size);
+        else if (transfer(th, msg, 0) < 0) {
+            perror("bench: read error");
+            exit(EXIT_FAILURE);
+        }
+
+        memcpy(&stamp, msg, sizeof(stamp));
+        th->samples[i] = now_ns() - stamp;
+    }
+
+    free(msg);
+    return NULL;
+}
+
+static int transfer(bench_thread_t *th, char *msg, int send)
+{
+    unsigned int size = th->opts->size, done = 0;
+    ssize_t      ret;
+
+    while (done < size) {
+        ret = send ? write(th->fd, msg + done, size - done) : read(th->fd, msg + done, size - done);
+
+        if (ret < 0 && errno == EAGAIN)
+            continue;
+
+        /* end of file means the peer is gone */
+        if (ret <= 0) {
+            if (!ret)
+                errno = EPIPE;
+
+            return -1;
+        }
+
+        done += ret;
+
+        /* message transports must not split a message */
+        if (done != size && th->transport != T_PIPE) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static shm_queue_t *shm_create(unsigned int depth, unsigned int size)
+{
+    unsigned long long slots = 1, i;
+    shm_queue_t *queue;
+
+    while (slots < depth)
+        slots <<= 1;
+
+    queue = aligned_alloc(CACHE_LINE, sizeof(shm_queue_t));
+
+    if (!queue) {
+        perror("bench: memory allocation error");
+        return NULL;
+    }
+
+    memset(queue, 0, sizeof(shm_queue_t));
+
+    /* memory is shared between threads the same way as between processes */
+    queue->length = slots * (sizeof(shm_slot_t) + size);
+    queue->slots  = mmap(NULL, queue->length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (queue->slots == MAP_FAILED) {
+        perror("bench: mmap error");
+        free(queue);
+        return NULL;
+    }
+
+    queue->data = (char *)(queue->slots + slots);
+    queue->mask = slots - 1;
+
+    for (i = 0; i < slots; i++)
+        queue->slots[i].seq = i;
+
+    return queue;
+}
+
+static void shm_push(shm_queue_t *queue, const char *msg, unsigned int size)
+{
+    unsigned long long pos, seq;
+    shm_slot_t *slot;
+
+    pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        /* slot is free for this position, try to take it */
+        if (seq == pos) {
+            if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if ((long long)(seq - pos) < 0) {
+            /* queue is full */
+            sched_yield();
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+        else
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    }
+
+    memcpy(queue->data + (pos & queue->mask) * size, msg, size);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+static void shm_pop(shm_queue_t *queue, char *msg, unsigned int size)
+{
+    unsigned long long pos, seq;
+    shm_slot_t *slot;
+
+    pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+
+    for (;;) {
+        slot = &queue->slots[pos & queue->mask];
+        seq  = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        /* slot is filled for this position, try to take it */
+        if (seq == pos + 1) {
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if ((long long)(seq - (pos + 1)) < 0) {
+            /* queue is empty */
+            sched_yield();
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+        else
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    }
+
+    memcpy(msg, queue->data + (pos & queue->mask) * size, size);
+    __atomic_store_n(&slot->seq, pos + queue->mask + 1, __ATOMIC_RELEASE);
+}
+
+static void report(const bench_opts_t *opts, int transport, const bench_result_t *result)
+{
+    double rate  = opts->messages / result->seconds;
+    double gbps  = rate * opts->size / 1e9;
+    const char *mode = opts->nonblock ? "nonblock" : "block";
+
+    switch (opts->format) {
+        case F_CSV:
+            printf("%s,%u,%u,%u,%u,%u,%s,%.6f,%.0f,%.6f,%llu,%llu,%llu,%llu,%llu\n",
+                   transport_names[transport], opts->size, opts->messages, opts->depth,
+                   opts->producers, opts->consumers, mode, result->seconds, rate, gbps,
+                   result->p50, result->p90, result->p99, result->p999, result->max);
+            break;
+
+        case F_JSON:
+            printf("{\"transport\":\"%s\",\"size\":%u,\"messages\":%u,\"depth\":%u,"
+                   "\"producers\":%u,\"consumers\":%u,\"mode\":\"%s\",\"seconds\":%.6f,"
+                   "\"msgs_per_sec\":%.0f,\"gb_per_sec\":%.6f,\"p50_ns\":%llu,\"p90_ns\":%llu,"
+                   "\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu}\n",
+                   transport_names[transport], opts->size, opts->messages, opts->depth,
+                   opts->producers, opts->consumers, mode, result->seconds, rate, gbps,
+                   result->p50, result->p90, result->p99, result->p999, result->max);
+            break;
+
+        default:
+            printf("%-5s %8u %9.3f %13.0f %9.3f %9llu %9llu %9llu %9llu\n",
+                   transport_names[transport], opts->size, result->seconds, rate, gbps,
+                   result->p50, result->p99, result->p999, result->max);
+            break;
+    }
+}
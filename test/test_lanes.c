@@ -0,0 +1,180 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST PRIORITY LANES (per-file lanes, priority order & weights, root rights required) */
+
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+
+#include "test.h"
+
+#define LANES        3
+#define URGENT_LANE  2
+#define URGENT_QUOTA 2 /* consecutive reads of urgent lane while lower lanes have data */
+
+/**
+ * @brief Open device file in non-blocking mode with given lane.
+ *
+ * @param [in] lane - given lane of write().
+ * @return device file descriptor.
+ */
+static int open_lane(int lane)
+{
+    int fd = open(DEVICE_NAME, O_RDWR | O_NONBLOCK);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_LANE, lane) < 0) {
+        perror("set lane error");
+        exit(EXIT_FAILURE);
+    }
+
+    return fd;
+}
+
+/**
+ * @brief Write message.
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] message - given message.
+ */
+static void write_msg(int fd, const char *message)
+{
+    if (write(fd, message, strlen(message)) != (ssize_t)strlen(message)) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Check whether urgent data is reported by poll().
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] expected - given expected presence of POLLPRI.
+ */
+static void check_pri(int fd, int expected)
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLIN | POLLPRI};
+
+    if (poll(&pfd, 1, 0) != 1 || !(pfd.revents & POLLIN) || !(pfd.revents & POLLPRI) != !expected) {
+        printf("lanes: poll returned events %#x\n", pfd.revents);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void)
+{
+    const char *order[] = {"urgent 0", "urgent 1", "mid", "urgent 2", "urgent 3",
+                           "bulk 0", "bulk 1", "bulk 2", "bulk 3"};
+    char buffer[BUFFER_SIZE], message[BUFFER_SIZE];
+    int  bulk, mid, urgent, ret, i;
+    dev_lanes_t lanes;
+
+    bulk = open_lane(0);
+
+    memset(&lanes, 0, sizeof(lanes));
+    lanes.lanes = LANES;
+    lanes.weights[URGENT_LANE] = URGENT_QUOTA;
+
+    /* every lane allocates a ring buffer, so lanes are limited to privileged users */
+    if (geteuid() != 0) {
+        if (ioctl(bulk, IOCTL_LANES, &lanes) != -1 || errno != EPERM) {
+            puts("lanes: lanes set by unprivileged user");
+            exit(EXIT_FAILURE);
+        }
+
+        puts("lanes: refused to unprivileged user, run as root to test lanes");
+        close(bulk);
+        return 0;
+    }
+
+    lanes.lanes = LANES_MAX + 1;
+
+    if (ioctl(bulk, IOCTL_LANES, &lanes) != -1 || errno != EINVAL) {
+        puts("lanes: incorrect number of lanes accepted");
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(bulk, IOCTL_LANE, LANES_MAX) != -1 || errno != EINVAL) {
+        puts("lanes: incorrect lane accepted");
+        exit(EXIT_FAILURE);
+    }
+
+    lanes.lanes = LANES;
+
+    if (ioctl(bulk, IOCTL_MSG_MODE, 1) < 0 || ioctl(bulk, IOCTL_LANES, &lanes) < 0) {
+        perror("set lanes error");
+        exit(EXIT_FAILURE);
+    }
+
+    mid    = open_lane(1);
+    urgent = open_lane(URGENT_LANE);
+
+    /* bulk backlog is queued before urgent messages */
+    for (i = 0; i < 4; i++) {
+        snprintf(message, BUFFER_SIZE, "bulk %d", i);
+        write_msg(bulk, message);
+    }
+
+    check_pri(bulk, 0);
+    write_msg(mid, "mid");
+
+    for (i = 0; i < 4; i++) {
+        snprintf(message, BUFFER_SIZE, "urgent %d", i);
+        write_msg(urgent, message);
+    }
+
+    check_pri(bulk, 1);
+    puts("lanes: urgent data reported by poll");
+
+    /* the highest lane first, its weight gives lower lanes a read */
+    for (i = 0; i < (int)(sizeof(order) / sizeof(order[0])); i++) {
+        memset(buffer, 0, BUFFER_SIZE);
+        ret = read(bulk, buffer, BUFFER_SIZE);
+
+        if (ret != (int)strlen(order[i]) || memcmp(buffer, order[i], ret) != 0) {
+            printf("lanes: read \"%s\" instead of \"%s\"\n", buffer, order[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        printf("lanes: read \"%s\"\n", buffer);
+    }
+
+    if (read(bulk, buffer, BUFFER_SIZE) != -1 || errno != EAGAIN) {
+        puts("lanes: lanes are not empty");
+        exit(EXIT_FAILURE);
+    }
+
+    puts("lanes: messages read in priority order with weights");
+
+    memset(&lanes, 0, sizeof(lanes));
+    lanes.lanes = 1;
+
+    if (ioctl(bulk, IOCTL_LANES, &lanes) < 0) {
+        perror("remove lanes error");
+        exit(EXIT_FAILURE);
+    }
+
+    ioctl(bulk, IOCTL_MSG_MODE, 0);
+    close(urgent);
+    close(mid);
+    close(bulk);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST LATENCY HISTOGRAMS (wait & residence time) */
+
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define LAT_PARAM "/sys/module/linux_driver/parameters/latency_hist"
+
+/**
+ * @brief Get number of samples in latency histogram.
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] type - given histogram type (LAT_*).
+ * @return sum of histogram buckets.
+ */
+static unsigned long long lat_total(int fd, unsigned int type)
+{
+    dev_lat_hist_t hist;
+    unsigned long long total = 0;
+    int i;
+
+    memset(&hist, 0, sizeof(hist));
+    hist.type = type;
+
+    if (ioctl(fd, IOCTL_LAT_HIST, &hist) < 0) {
+        perror("get latency histogram error");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < LAT_BUCKETS; i++)
+        total += hist.counts[i];
+
+    return total;
+}
+
+int main(void)
+{
+    const char *message = "latency";
+    int  len = strlen(message);
+    char buffer[BUFFER_SIZE];
+    dev_lat_hist_t hist;
+    FILE *param;
+    int  fd, ret, enabled = 0;
+    unsigned int type;
+
+    /* histograms are collected only with latency_hist=1 */
+    param = fopen(LAT_PARAM, "r");
+
+    if (param) {
+        enabled = fgetc(param) == 'Y';
+        fclose(param);
+    }
+
+    fd = open(DEVICE_NAME, O_RDWR);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    memset(&hist, 0, sizeof(hist));
+    hist.type = LAT_RESIDENCE + 1;
+
+    if (ioctl(fd, IOCTL_LAT_HIST, &hist) != -1 || errno != EINVAL) {
+        puts("lat: incorrect histogram type accepted");
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_LAT_RESET) < 0) {
+        perror("reset latency histograms error");
+        exit(EXIT_FAILURE);
+    }
+
+    for (type = LAT_READ_WAIT; type <= LAT_RESIDENCE; type++) {
+        if (lat_total(fd, type)) {
+            printf("lat: histogram %u is not empty after reset\n", type);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    puts("lat: histograms reset");
+
+    /* read wait is measured even if it timed out */
+    if (ioctl(fd, IOCTL_BLOCK) < 0 || ioctl(fd, IOCTL_READ_TIMEOUT, 50) < 0) {
+        perror("set read timeout error");
+        exit(EXIT_FAILURE);
+    }
+
+    ret = read(fd, buffer, BUFFER_SIZE);
+
+    if (ret != -1 || errno != ETIMEDOUT) {
+        printf("lat: read returned %d instead of timeout\n", ret);
+        exit(EXIT_FAILURE);
+    }
+
+    /* residence time of written data */
+    if (write(fd, message, len) != len) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+
+    usleep(10000);
+
+    if (read(fd, buffer, BUFFER_SIZE) != len) {
+        perror("read error");
+        exit(EXIT_FAILURE);
+    }
+
+    if (lat_total(fd, LAT_READ_WAIT) != (unsigned long long)enabled ||
+        lat_total(fd, LAT_RESIDENCE) != (unsigned long long)enabled ||
+        lat_total(fd, LAT_WRITE_WAIT) != 0) {
+        printf("lat: incorrect number of samples (latency_hist=%d)\n", enabled);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("lat: %s\n", enabled ? "read wait & residence time measured" : "histograms are disabled");
+
+    ioctl(fd, IOCTL_READ_TIMEOUT, 0);
+    close(fd);
+    return 0;
+}
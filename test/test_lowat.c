@@ -0,0 +1,232 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST WAKE UP WATERMARKS (read_lowat, IOCTL_FLUSH & flush timer) */
+
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define READ_LOWAT  16
+#define LOWAT_MSGS  3
+#define FLUSH_DELAY 20000 /* microseconds */
+#define HOLD_TIME   50000 /* microseconds */
+
+/** @brief Blocked reader thread structure. */
+typedef struct {
+    pthread_t thread;
+    int       fd;
+    int       ret;
+    int       done;
+    struct timespec end;
+} reader_t;
+
+static char buffer[BUFFER_SIZE];
+
+/**
+ * @brief Read once & record completion time.
+ *
+ * @param [in] arg - given reader structure.
+ */
+static void *reader(void *arg)
+{
+    reader_t *r = arg;
+
+    r->ret = read(r->fd, buffer, BUFFER_SIZE);
+    clock_gettime(CLOCK_MONOTONIC, &r->end);
+    __atomic_store_n(&r->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * @brief Start reader & wait until it sleeps on empty ring buffer.
+ *
+ * @param [in] r - given reader structure.
+ */
+static void reader_start(reader_t *r)
+{
+    long long sleeps = read_attr("statistics/read_sleeps");
+
+    r->done = 0;
+
+    if (pthread_create(&r->thread, NULL, reader, r) != 0) {
+        perror("pthread_create error");
+        exit(EXIT_FAILURE);
+    }
+
+    while (read_attr("statistics/read_sleeps") == sleeps)
+        usleep(1000);
+
+    /* sleep is counted right before the reader goes to sleep */
+    usleep(10000);
+}
+
+/**
+ * @brief Write data of given length.
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] len - given data length.
+ */
+static void write_data(int fd, int len)
+{
+    if (write(fd, "0123456789abcdef", len) != len) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Check that reader is still held back.
+ *
+ * @param [in] r - given reader structure.
+ * @param [in] descr - given description of the check.
+ */
+static void check_held(reader_t *r, const char *descr)
+{
+    usleep(HOLD_TIME);
+
+    if (__atomic_load_n(&r->done, __ATOMIC_ACQUIRE)) {
+        printf("lowat: reader woken %s\n", descr);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Wait for reader & check amount of read data.
+ *
+ * @param [in] r - given reader structure.
+ * @param [in] expected - given expected read() result.
+ */
+static void reader_join(reader_t *r, int expected)
+{
+    pthread_join(r->thread, NULL);
+
+    if (r->ret != expected) {
+        printf("lowat: read returned %d instead of %d\n", r->ret, expected);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void)
+{
+    struct timespec start;
+    dev_lowat_t lowat;
+    reader_t r;
+    long elapsed;
+    int  fd, i;
+
+    fd = open(DEVICE_NAME, O_RDWR);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    r.fd = fd;
+    memset(&lowat, 0, sizeof(lowat));
+    lowat.flush_delay = 1000001;
+
+    if (ioctl(fd, IOCTL_LOWAT, &lowat) != -1 || errno != EINVAL) {
+        puts("lowat: too long flush delay accepted");
+        exit(EXIT_FAILURE);
+    }
+
+    lowat.read_lowat  = READ_LOWAT;
+    lowat.flush_delay = 0;
+
+    if (ioctl(fd, IOCTL_BLOCK) < 0 || ioctl(fd, IOCTL_LOWAT, &lowat) < 0) {
+        perror("set watermarks error");
+        exit(EXIT_FAILURE);
+    }
+
+    /* data below read_lowat is held back until IOCTL_FLUSH */
+    reader_start(&r);
+    write_data(fd, 4);
+    check_held(&r, "below read_lowat");
+
+    if (ioctl(fd, IOCTL_FLUSH) < 0) {
+        perror("flush error");
+        exit(EXIT_FAILURE);
+    }
+
+    reader_join(&r, 4);
+    puts("lowat: held back data released by flush");
+
+    /* reader is woken once read_lowat bytes are queued */
+    reader_start(&r);
+    write_data(fd, 4);
+    check_held(&r, "below read_lowat");
+    write_data(fd, READ_LOWAT - 4);
+    reader_join(&r, READ_LOWAT);
+    puts("lowat: reader woken at read_lowat");
+
+    /* held back data is released by flush timer */
+    lowat.flush_delay = FLUSH_DELAY;
+
+    if (ioctl(fd, IOCTL_LOWAT, &lowat) < 0) {
+        perror("set watermarks error");
+        exit(EXIT_FAILURE);
+    }
+
+    reader_start(&r);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    write_data(fd, 4);
+    reader_join(&r, 4);
+
+    elapsed = (r.end.tv_sec - start.tv_sec) * 1000000 + (r.end.tv_nsec - start.tv_nsec) / 1000;
+
+    if (elapsed < FLUSH_DELAY) {
+        printf("lowat: reader woken after %ld us before flush delay\n", elapsed);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("lowat: held back data released by flush timer after %ld us\n", elapsed);
+
+    /* in message mode reader is woken once read_lowat_msgs messages are queued */
+    memset(&lowat, 0, sizeof(lowat));
+    lowat.read_lowat      = BUFFER_SIZE;
+    lowat.read_lowat_msgs = LOWAT_MSGS;
+
+    if (ioctl(fd, IOCTL_MSG_MODE, 1) < 0 || ioctl(fd, IOCTL_LOWAT, &lowat) < 0) {
+        perror("set message watermark error");
+        exit(EXIT_FAILURE);
+    }
+
+    reader_start(&r);
+    write_data(fd, 1);
+    write_data(fd, 1);
+    check_held(&r, "below read_lowat_msgs");
+    write_data(fd, 1);
+    reader_join(&r, 1);
+
+    /* the rest of messages is already queued */
+    for (i = 1; i < LOWAT_MSGS; i++) {
+        if (read(fd, buffer, BUFFER_SIZE) != 1) {
+            perror("read error");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    puts("lowat: reader woken at read_lowat_msgs");
+
+    memset(&lowat, 0, sizeof(lowat));
+    ioctl(fd, IOCTL_LOWAT, &lowat);
+    ioctl(fd, IOCTL_MSG_MODE, 0);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,195 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST MMAP (zero-copy producer & consumer) */
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <string.h>
+
+#include "test.h"
+
+#define TRANSFER_SIZE (16 * 1024 * 1024)
+
+/**
+ * @brief Map device ring buffer.
+ * 
+ * @param [in] fd - given device file descriptor.
+ * @param [out] data - given pointer to store ring buffer data address.
+ * @return ring buffer control structure.
+ */
+static ring_ctrl_t *map_ring(int fd, unsigned char **data);
+
+/** @brief Write TRANSFER_SIZE bytes through the shared mapping. */
+static void producer(ring_ctrl_t *ctrl, unsigned char *data, int fd);
+
+/** @brief Read & check TRANSFER_SIZE bytes through the shared mapping. */
+static void consumer(ring_ctrl_t *ctrl, unsigned char *data, int fd);
+
+
+int main(void)
+{
+    unsigned char *data;
+    ring_ctrl_t   *ctrl;
+    int   fd, status;
+    pid_t pid;
+
+    fd = open(DEVICE_NAME, O_RDWR);
+    
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    ctrl = map_ring(fd, &data);
+    printf("mmap: ring buffer size: %u bytes\n", ctrl->size);
+
+    pid = fork();
+
+    if (pid == -1) {
+        perror("fork error");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pid == 0) {
+        consumer(ctrl, data, fd);
+        exit(EXIT_SUCCESS);
+    }
+
+    producer(ctrl, data, fd);
+    waitpid(pid, &status, 0);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        puts("mmap: consumer failed");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("mmap: transferred %d bytes\n", TRANSFER_SIZE);
+    close(fd);
+    return 0;
+}
+
+static ring_ctrl_t *map_ring(int fd, unsigned char **data)
+{
+    long        page_size;
+    ring_ctrl_t *ctrl;
+    void        *addr;
+    
+    page_size = sysconf(_SC_PAGESIZE);
+
+    /* map control page to find out the ring buffer size */
+    ctrl = mmap(NULL, page_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (ctrl == MAP_FAILED) {
+        perror("mmap error");
+        exit(EXIT_FAILURE);
+    }
+
+    /* data pages are mapped twice, so any region of up to size bytes is contiguous */
+    addr = mmap(NULL, page_size + 2 * (size_t)ctrl->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    munmap(ctrl, page_size);
+
+    if (addr == MAP_FAILED) {
+        perror("mmap error");
+        exit(EXIT_FAILURE);
+    }
+    
+    *data = (unsigned char *)addr + page_size;
+    return addr;
+}
+
+static void producer(ring_ctrl_t *ctrl, unsigned char *data, int fd)
+{
+    unsigned int head, tail, count, i;
+    unsigned char *dst;
+    size_t sent = 0;
+
+    while (sent < TRANSFER_SIZE) {
+        head = ctrl->head;
+        tail = __atomic_load_n(&ctrl->tail, __ATOMIC_ACQUIRE);
+
+        /* ring buffer is full - sleep in the kernel */
+        if (head - tail == ctrl->size) {
+            if (ioctl(fd, IOCTL_WAIT_WRITE, 1) < 0) {
+                perror("IOCTL_WAIT_WRITE error");
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+        
+        count = ctrl->size - (head - tail);
+
+        if (count > TRANSFER_SIZE - sent)
+            count = TRANSFER_SIZE - sent;
+
+        /* free space is written without wrap around thanks to the mirrored mapping */
+        dst = data + (head & (ctrl->size - 1));
+
+        for (i = 0; i < count; i++)
+            dst[i] = (unsigned char)(sent + i);
+
+        head += count;
+        sent += count;
+
+        __atomic_store_n(&ctrl->head, head, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        /* enter the kernel only if consumer sleeps */
+        if (__atomic_load_n(&ctrl->read_waiters, __ATOMIC_RELAXED))
+            ioctl(fd, IOCTL_WAKE);
+    }
+}
+
+static void consumer(ring_ctrl_t *ctrl, unsigned char *data, int fd)
+{
+    unsigned int head, tail, i;
+    unsigned char *src;
+    size_t received = 0;
+
+    while (received < TRANSFER_SIZE) {
+        tail = ctrl->tail;
+        head = __atomic_load_n(&ctrl->head, __ATOMIC_ACQUIRE);
+
+        /* ring buffer is empty - sleep in the kernel */
+        if (head == tail) {
+            if (ioctl(fd, IOCTL_WAIT_READ, 1) < 0) {
+                perror("IOCTL_WAIT_READ error");
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+
+        /* queued data is parsed in place without wrap around */
+        src = data + (tail & (ctrl->size - 1));
+
+        for (i = 0; i < head - tail; i++) {
+            if (src[i] != (unsigned char)(received + i)) {
+                printf("mmap: data mismatch at byte %zu\n", received + i);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        received += head - tail;
+        tail      = head;
+
+        __atomic_store_n(&ctrl->tail, tail, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        /* enter the kernel only if producer sleeps */
+        if (__atomic_load_n(&ctrl->write_waiters, __ATOMIC_RELAXED))
+            ioctl(fd, IOCTL_WAKE);
+    }
+}
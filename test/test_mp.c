@@ -0,0 +1,117 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST MULTI-PRODUCER MODE (concurrent writers, atomic messages in order) */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "test.h"
+
+#define PRODUCERS 8
+#define MESSAGES  10000
+#define MSG_SIZE  64
+
+typedef struct {
+    unsigned int producer;
+    unsigned int seq;
+    char         fill[MSG_SIZE - 2 * sizeof(unsigned int)];
+} mp_msg_t;
+
+static int fd;
+
+static void *producer(void *arg)
+{
+    unsigned int id = (unsigned int)(unsigned long)arg;
+    mp_msg_t msg;
+    size_t   len;
+
+    for (msg.seq = 0; msg.seq < MESSAGES; msg.seq++) {
+        msg.producer = id;
+
+        /* variable length, payload is checked by the consumer */
+        len = sizeof(msg) - (msg.seq % sizeof(msg.fill));
+        memset(msg.fill, (char)(id + msg.seq), sizeof(msg.fill));
+
+        if (write(fd, &msg, len) != (ssize_t)len) {
+            perror("mp: write error");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return NULL;
+}
+
+int main(void)
+{
+    unsigned int next[PRODUCERS] = {0};
+    pthread_t threads[PRODUCERS];
+    mp_msg_t  msg;
+    size_t    len, i;
+    ssize_t   ret;
+    long      id;
+
+    fd = open(DEVICE_NAME, O_RDWR);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_MSG_MODE, 1) < 0 || ioctl(fd, IOCTL_MP_MODE, 1) < 0) {
+        perror("set multi-producer mode error");
+        exit(EXIT_FAILURE);
+    }
+
+    for (id = 0; id < PRODUCERS; id++)
+        pthread_create(&threads[id], NULL, producer, (void *)id);
+
+    /* messages of every producer arrive whole & in the order they were written */
+    for (i = 0; i < PRODUCERS * MESSAGES; i++) {
+        ret = read(fd, &msg, sizeof(msg));
+
+        if (ret < (ssize_t)(2 * sizeof(unsigned int)) || msg.producer >= PRODUCERS) {
+            printf("mp: incorrect message of %zd bytes\n", ret);
+            exit(EXIT_FAILURE);
+        }
+
+        len = sizeof(msg) - (msg.seq % sizeof(msg.fill));
+
+        if (msg.seq != next[msg.producer] || (size_t)ret != len) {
+            printf("mp: producer %u message %u out of order\n", msg.producer, msg.seq);
+            exit(EXIT_FAILURE);
+        }
+
+        for (len -= 2 * sizeof(unsigned int); len; len--) {
+            if (msg.fill[len - 1] != (char)(msg.producer + msg.seq)) {
+                printf("mp: producer %u message %u corrupted\n", msg.producer, msg.seq);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        next[msg.producer]++;
+    }
+
+    for (id = 0; id < PRODUCERS; id++)
+        pthread_join(threads[id], NULL);
+
+    printf("mp: %d producers transferred %d messages each\n", PRODUCERS, MESSAGES);
+
+    ioctl(fd, IOCTL_MP_MODE, 0);
+    ioctl(fd, IOCTL_MSG_MODE, 0);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,116 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST MESSAGE MODE (framed messages & batch IOCTLs) */
+
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define MSG_COUNT 3
+
+int main(void)
+{
+    const char *messages[MSG_COUNT] = {"first", "", "third message"};
+    char buffers[MSG_COUNT][BUFFER_SIZE];
+    dev_msg_t msgs[MSG_COUNT];
+    dev_msg_batch_t batch;
+    char buffer[BUFFER_SIZE];
+    int  fd, ret, i;
+
+    fd = open(DEVICE_NAME, O_RDWR);
+    
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_MSG_MODE, 1) < 0 || ioctl(fd, IOCTL_NONBLOCK) < 0) {
+        perror("set message mode error");
+        exit(EXIT_FAILURE);
+    }
+
+    /* single message per write() & read() */
+    if (write(fd, "binary\0data", 11) != 11) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+
+    ret = read(fd, buffer, BUFFER_SIZE);
+
+    if (ret != 11 || memcmp(buffer, "binary\0data", 11) != 0) {
+        printf("msg: incorrect message read: %d bytes\n", ret);
+        exit(EXIT_FAILURE);
+    }
+
+    puts("msg: single message transferred");
+
+    /* batch of messages per IOCTL */
+    for (i = 0; i < MSG_COUNT; i++) {
+        msgs[i].buf = (unsigned long long)(unsigned long)messages[i];
+        msgs[i].len = strlen(messages[i]);
+    }
+
+    batch.msgs  = (unsigned long long)(unsigned long)msgs;
+    batch.count = MSG_COUNT;
+    ret = ioctl(fd, IOCTL_SEND_BATCH, &batch);
+
+    if (ret != MSG_COUNT) {
+        printf("msg: sent %d messages instead of %d\n", ret, MSG_COUNT);
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < MSG_COUNT; i++) {
+        msgs[i].buf = (unsigned long long)(unsigned long)buffers[i];
+        msgs[i].len = BUFFER_SIZE;
+    }
+
+    ret = ioctl(fd, IOCTL_RECV_BATCH, &batch);
+
+    if (ret != MSG_COUNT) {
+        printf("msg: received %d messages instead of %d\n", ret, MSG_COUNT);
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < MSG_COUNT; i++) {
+        if (msgs[i].len != strlen(messages[i]) || memcmp(buffers[i], messages[i], msgs[i].len) != 0) {
+            printf("msg: incorrect message %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("msg: batch of %d messages transferred\n", MSG_COUNT);
+
+    /* blocking read of empty ring buffer with timeout of this file */
+    if (ioctl(fd, IOCTL_BLOCK) < 0 || ioctl(fd, IOCTL_READ_TIMEOUT, 100) < 0) {
+        perror("set read timeout error");
+        exit(EXIT_FAILURE);
+    }
+
+    ret = read(fd, buffer, BUFFER_SIZE);
+
+    if (ret != -1 || errno != ETIMEDOUT) {
+        printf("msg: read returned %d instead of timeout\n", ret);
+        exit(EXIT_FAILURE);
+    }
+
+    puts("msg: read timed out");
+
+    ioctl(fd, IOCTL_MSG_MODE, 0);
+    close(fd);
+    return 0;
+}
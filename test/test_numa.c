@@ -0,0 +1,162 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST NUMA PLACEMENT (explicit node & node of the first reader, root rights required) */
+
+#include <sys/syscall.h>
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define STATS_FILE "/sys/kernel/debug/linux_driver/test_task_dev0/statistics"
+
+/**
+ * @brief Get actual node of the ring buffer from debugfs statistics.
+ *
+ * @return node of the ring buffer pages.
+ */
+static int ring_node(void)
+{
+    char line[128];
+    FILE *file;
+    int  node = -1;
+
+    file = fopen(STATS_FILE, "r");
+
+    if (!file) {
+        perror(STATS_FILE);
+        exit(EXIT_FAILURE);
+    }
+
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "node: %d", &node) == 1)
+            break;
+    }
+
+    fclose(file);
+    return node;
+}
+
+/**
+ * @brief Set ring buffer placement & check result.
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] node - given node.
+ * @param [in] expected - given expected errno (0 - success).
+ */
+static void place(int fd, long node, int expected)
+{
+    int ret = ioctl(fd, IOCTL_NUMA_NODE, node);
+
+    if ((ret < 0 ? errno : 0) != expected) {
+        printf("numa: placement on node %ld returned %d (%s)\n", node, ret, ret < 0 ? strerror(errno) : "success");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Check that queued data is preserved.
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] message - given queued message.
+ */
+static void check_data(int fd, const char *message)
+{
+    char buffer[BUFFER_SIZE];
+    int  len = strlen(message);
+
+    memset(buffer, 0, BUFFER_SIZE);
+
+    if (read(fd, buffer, BUFFER_SIZE) != len || memcmp(buffer, message, len) != 0) {
+        printf("numa: queued data is corrupted: \"%s\"\n", buffer);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void)
+{
+    const char *message = "placement";
+    int  len = strlen(message);
+    unsigned int node;
+    int  fd, reader;
+    long long saved;
+
+    fd = open(DEVICE_NAME, O_WRONLY | O_NONBLOCK);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    /* placement reallocates the ring buffer, so it is limited to privileged users */
+    if (geteuid() != 0) {
+        place(fd, 0, EPERM);
+        puts("numa: refused to unprivileged user, run as root to test placement");
+        close(fd);
+        return 0;
+    }
+
+    saved = read_attr("numa_node");
+
+    place(fd, RING_NODE_READER - 1, EINVAL);
+    place(fd, 1 << 20, EINVAL);
+
+    /* explicit node, queued data moves with the ring buffer */
+    if (write(fd, message, len) != len) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+
+    place(fd, 0, 0);
+
+    if (read_attr("numa_node") != 0 || ring_node() != 0) {
+        printf("numa: ring buffer is on node %d instead of 0\n", ring_node());
+        exit(EXIT_FAILURE);
+    }
+
+    puts("numa: ring buffer placed on node 0");
+
+    /* the first reader moves ring buffer to its node at open */
+    place(fd, RING_NODE_READER, 0);
+
+    if (read_attr("numa_node") != RING_NODE_READER) {
+        printf("numa: numa_node is %lld instead of %d\n", read_attr("numa_node"), RING_NODE_READER);
+        exit(EXIT_FAILURE);
+    }
+
+    /* node of this task is the reader node unless it migrates meanwhile */
+    syscall(SYS_getcpu, NULL, &node, NULL);
+    reader = open(DEVICE_NAME, O_RDONLY | O_NONBLOCK);
+
+    if (reader == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ring_node() != (int)node) {
+        printf("numa: ring buffer is on node %d instead of reader node %u\n", ring_node(), node);
+        exit(EXIT_FAILURE);
+    }
+
+    check_data(reader, message);
+    printf("numa: ring buffer placed on reader node %u\n", node);
+
+    close(reader);
+    place(fd, saved, 0);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,166 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST OVERWRITE MODE (oldest data is dropped & accounted) */
+
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define DROP_SIZE 16
+#define MSG_SIZE  100
+#define MSG_HDR   4
+
+/**
+ * @brief Read from device & check that reader is told about the gap.
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] buffer - given read buffer.
+ * @param [in] size - given read buffer size.
+ * @return number of bytes lost by this file so far.
+ */
+static unsigned long long read_gap(int fd, char *buffer, int size)
+{
+    unsigned long long lost;
+    int ret;
+
+    ret = read(fd, buffer, size);
+
+    if (ret != -1 || errno != EOVERFLOW) {
+        printf("overwrite: read returned %d instead of EOVERFLOW\n", ret);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_LOST, &lost) < 0) {
+        perror("get lost bytes error");
+        exit(EXIT_FAILURE);
+    }
+
+    return lost;
+}
+
+int main(void)
+{
+    unsigned long long lost;
+    long long lost_msgs;
+    char *data, *buffer;
+    int  fd, size, ret, i, count, next;
+
+    fd = open(DEVICE_NAME, O_RDWR | O_NONBLOCK);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    size   = read_attr("size");
+    data   = malloc(size);
+    buffer = malloc(size);
+
+    if (!data || !buffer) {
+        perror("malloc error");
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_OVERWRITE, 2) != -1 || errno != EINVAL) {
+        puts("overwrite: incorrect mode accepted");
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_OVERWRITE, 1) < 0) {
+        perror("set overwrite mode error");
+        exit(EXIT_FAILURE);
+    }
+
+    /* byte stream: the oldest bytes are dropped */
+    for (i = 0; i < size; i++)
+        data[i] = 'a' + i % 26;
+
+    if (write(fd, data, size) != size || write(fd, "0123456789abcdef", DROP_SIZE) != DROP_SIZE) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+
+    lost = read_gap(fd, buffer, size);
+    ret  = read(fd, buffer, size);
+
+    if (lost != DROP_SIZE) {
+        printf("overwrite: %llu bytes lost instead of %d\n", lost, DROP_SIZE);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ret != size || memcmp(buffer, data + DROP_SIZE, size - DROP_SIZE) != 0 ||
+        memcmp(buffer + size - DROP_SIZE, "0123456789abcdef", DROP_SIZE) != 0) {
+        printf("overwrite: read %d bytes of incorrect data after gap\n", ret);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("overwrite: %llu oldest bytes dropped\n", lost);
+
+    /* messages: the oldest whole messages are dropped */
+    if (ioctl(fd, IOCTL_MSG_MODE, 1) < 0) {
+        perror("set message mode error");
+        exit(EXIT_FAILURE);
+    }
+
+    count     = size / (MSG_SIZE + MSG_HDR) + 5;
+    lost_msgs = read_attr("statistics/lost_msgs");
+
+    for (i = 0; i < count; i++) {
+        memset(data, 0, MSG_SIZE);
+        snprintf(data, MSG_SIZE, "message %d", i);
+
+        if (write(fd, data, MSG_SIZE) != MSG_SIZE) {
+            perror("write error");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    lost_msgs = read_attr("statistics/lost_msgs") - lost_msgs;
+    lost      = read_gap(fd, buffer, size) - lost;
+
+    if (lost_msgs <= 0 || lost != (unsigned long long)lost_msgs * (MSG_SIZE + MSG_HDR)) {
+        printf("overwrite: %lld messages & %llu bytes lost\n", lost_msgs, lost);
+        exit(EXIT_FAILURE);
+    }
+
+    /* the newest messages are kept in order */
+    next = lost_msgs;
+
+    while ((ret = read(fd, buffer, size)) == MSG_SIZE) {
+        snprintf(data, MSG_SIZE, "message %d", next++);
+
+        if (strcmp(buffer, data) != 0) {
+            printf("overwrite: got \"%s\" instead of \"%s\"\n", buffer, data);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (ret != -1 || errno != EAGAIN || next != count) {
+        printf("overwrite: %d messages read after gap\n", next - (int)lost_msgs);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("overwrite: %lld oldest messages dropped, newest %d messages kept\n", lost_msgs, count - (int)lost_msgs);
+
+    ioctl(fd, IOCTL_MSG_MODE, 0);
+    ioctl(fd, IOCTL_OVERWRITE, 0);
+    close(fd);
+    free(data);
+    free(buffer);
+    return 0;
+}
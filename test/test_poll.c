@@ -0,0 +1,142 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST BUSY-POLL (spinning for data before sleeping) */
+
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define BUSY_POLL_MAX 1000 /* microseconds */
+#define WRITE_DELAY   100  /* microseconds */
+
+static const char *message = "busy-poll";
+static int ready = 0;
+
+/**
+ * @brief Write message shortly after reader started waiting.
+ *
+ * @param [in] arg - given device file descriptor.
+ */
+static void *writer(void *arg)
+{
+    struct timespec start, now;
+    int fd = *(int *)arg;
+
+    while (!__atomic_load_n(&ready, __ATOMIC_ACQUIRE))
+        ;
+
+    /* spin instead of sleep, so the write is not delayed by scheduler */
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+    } while ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000 < WRITE_DELAY);
+
+    if (write(fd, message, strlen(message)) != (ssize_t)strlen(message)) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+
+    return NULL;
+}
+
+int main(void)
+{
+    long long hits, misses;
+    char buffer[BUFFER_SIZE];
+    pthread_t thread;
+    int  fd, ret;
+
+    fd = open(DEVICE_NAME, O_RDWR);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_BUSY_POLL, BUSY_POLL_MAX + 1) != -1 || errno != EINVAL) {
+        puts("poll: too long busy-poll accepted");
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_BUSY_POLL, BUSY_POLL_MAX) < 0) {
+        perror("set busy-poll error");
+        exit(EXIT_FAILURE);
+    }
+
+    if (read_attr("busy_poll") != BUSY_POLL_MAX) {
+        printf("poll: busy_poll is %lld instead of %d\n", read_attr("busy_poll"), BUSY_POLL_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    /* nothing arrives while spinning */
+    if (ioctl(fd, IOCTL_BLOCK) < 0 || ioctl(fd, IOCTL_READ_TIMEOUT, 20) < 0) {
+        perror("set read timeout error");
+        exit(EXIT_FAILURE);
+    }
+
+    misses = read_attr("statistics/poll_misses");
+    ret    = read(fd, buffer, BUFFER_SIZE);
+
+    if (ret != -1 || errno != ETIMEDOUT) {
+        printf("poll: read returned %d instead of timeout\n", ret);
+        exit(EXIT_FAILURE);
+    }
+
+    if (read_attr("statistics/poll_misses") != misses + 1) {
+        puts("poll: busy-poll miss is not counted");
+        exit(EXIT_FAILURE);
+    }
+
+    puts("poll: busy-poll missed & reader slept");
+
+    /* data arrives while spinning, budget is restored to the full one */
+    if (ioctl(fd, IOCTL_BUSY_POLL, BUSY_POLL_MAX) < 0 || ioctl(fd, IOCTL_READ_TIMEOUT, 0) < 0) {
+        perror("set busy-poll error");
+        exit(EXIT_FAILURE);
+    }
+
+    if (pthread_create(&thread, NULL, writer, &fd) != 0) {
+        perror("pthread_create error");
+        exit(EXIT_FAILURE);
+    }
+
+    hits = read_attr("statistics/poll_hits");
+    __atomic_store_n(&ready, 1, __ATOMIC_RELEASE);
+
+    ret = read(fd, buffer, BUFFER_SIZE);
+    pthread_join(thread, NULL);
+
+    if (ret != (int)strlen(message) || memcmp(buffer, message, ret) != 0) {
+        printf("poll: read returned %d\n", ret);
+        exit(EXIT_FAILURE);
+    }
+
+    /* spinning reader & writer need separate CPUs */
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 1 && read_attr("statistics/poll_hits") != hits + 1) {
+        puts("poll: data did not arrive while spinning");
+        exit(EXIT_FAILURE);
+    }
+
+    puts("poll: data arrived while spinning");
+
+    ioctl(fd, IOCTL_BUSY_POLL, 0);
+    close(fd);
+    return 0;
+}
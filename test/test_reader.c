@@ -21,7 +21,7 @@
 #include <stdio.h>
 #include <fcntl.h>
 
-#define DEVICE_NAME "/dev/test_task_dev"
+#define DEVICE_NAME "/dev/test_task_dev0"
 #define BUFFER_SIZE 100
 
 int main()
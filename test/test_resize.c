@@ -0,0 +1,124 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST ONLINE RESIZE (queued data is preserved, root rights required) */
+
+#include <sys/mman.h>
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define CHUNK_SIZE 3000
+#define NEW_SIZE   5000 /* rounded up to 8192 */
+
+/**
+ * @brief Resize ring buffer & check result.
+ *
+ * @param [in] fd - given device file descriptor.
+ * @param [in] size - given new ring buffer size.
+ * @param [in] expected - given expected errno (0 - success).
+ */
+static void resize(int fd, unsigned long size, int expected)
+{
+    int ret = ioctl(fd, IOCTL_RESIZE, size);
+
+    if ((ret < 0 ? errno : 0) != expected) {
+        printf("resize: resize to %lu returned %d (%s)\n", size, ret, ret < 0 ? strerror(errno) : "success");
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void)
+{
+    char data[2 * CHUNK_SIZE], buffer[2 * CHUNK_SIZE];
+    long long size;
+    void *ctrl;
+    int  fd, i;
+
+    fd = open(DEVICE_NAME, O_RDWR);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    /* ring buffer is allocated by driver, so resize is limited to privileged users */
+    if (geteuid() != 0) {
+        resize(fd, NEW_SIZE, EPERM);
+        puts("resize: refused to unprivileged user, run as root to test resize");
+        close(fd);
+        return 0;
+    }
+
+    if (ioctl(fd, IOCTL_NONBLOCK) < 0) {
+        perror("set non-blocking mode error");
+        exit(EXIT_FAILURE);
+    }
+
+    size = read_attr("size");
+
+    for (i = 0; i < 2 * CHUNK_SIZE; i++)
+        data[i] = 'a' + i % 26;
+
+    /* grow ring buffer with queued data */
+    if (write(fd, data, CHUNK_SIZE) != CHUNK_SIZE) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+
+    resize(fd, NEW_SIZE, 0);
+
+    if (read_attr("size") != 8192) {
+        printf("resize: size is %lld instead of 8192\n", read_attr("size"));
+        exit(EXIT_FAILURE);
+    }
+
+    if (write(fd, data + CHUNK_SIZE, CHUNK_SIZE) != CHUNK_SIZE) {
+        perror("write after resize error");
+        exit(EXIT_FAILURE);
+    }
+
+    puts("resize: ring buffer grown with queued data");
+
+    /* queued data must fit into the new ring buffer */
+    resize(fd, 4096, EBUSY);
+    resize(fd, 0, EINVAL);
+
+    /* user space mapping can not be moved to the new ring buffer */
+    ctrl = mmap(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+
+    if (ctrl == MAP_FAILED) {
+        perror("mmap error");
+        exit(EXIT_FAILURE);
+    }
+
+    resize(fd, 16384, EBUSY);
+    munmap(ctrl, sysconf(_SC_PAGESIZE));
+
+    puts("resize: incorrect resizes refused");
+
+    if (read(fd, buffer, sizeof(buffer)) != sizeof(buffer) || memcmp(buffer, data, sizeof(buffer)) != 0) {
+        puts("resize: queued data is corrupted");
+        exit(EXIT_FAILURE);
+    }
+
+    puts("resize: queued data preserved");
+
+    resize(fd, size, 0);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST CHANNEL STATISTICS (sysfs counters & occupancy) */
+
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define STATS_COUNT 7
+
+static const char *names[STATS_COUNT] = {
+    "statistics/write_bytes", "statistics/write_ops", "statistics/read_bytes",
+    "statistics/read_ops",    "statistics/read_eagain", "statistics/empty_events",
+    "statistics/max_used"
+};
+
+/**
+ * @brief Read channel statistics.
+ *
+ * @param [out] stats - given array of STATS_COUNT counters.
+ */
+static void read_stats(long long *stats)
+{
+    int i;
+
+    for (i = 0; i < STATS_COUNT; i++)
+        stats[i] = read_attr(names[i]);
+}
+
+int main(void)
+{
+    long long before[STATS_COUNT], after[STATS_COUNT];
+    const char *message = "statistics";
+    int  len = strlen(message);
+    char buffer[BUFFER_SIZE];
+    int  fd, ret, i;
+
+    fd = open(DEVICE_NAME, O_RDWR);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_NONBLOCK) < 0) {
+        perror("set non-blocking mode error");
+        exit(EXIT_FAILURE);
+    }
+
+    read_stats(before);
+
+    if (write(fd, message, len) != len) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+
+    /* occupancy is shown until data is read */
+    if (read_attr("statistics/used") != len) {
+        printf("stats: used is %lld instead of %d\n", read_attr("statistics/used"), len);
+        exit(EXIT_FAILURE);
+    }
+
+    if (read(fd, buffer, BUFFER_SIZE) != len) {
+        perror("read error");
+        exit(EXIT_FAILURE);
+    }
+
+    /* read of empty ring buffer */
+    ret = read(fd, buffer, BUFFER_SIZE);
+
+    if (ret != -1 || errno != EAGAIN) {
+        printf("stats: read of empty ring buffer returned %d\n", ret);
+        exit(EXIT_FAILURE);
+    }
+
+    read_stats(after);
+
+    /* counters are monotonic */
+    for (i = 0; i < STATS_COUNT; i++) {
+        if (after[i] < before[i]) {
+            printf("stats: %s decreased from %lld to %lld\n", names[i], before[i], after[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (after[0] - before[0] != len || after[1] - before[1] != 1 ||
+        after[2] - before[2] != len || after[3] - before[3] != 1) {
+        puts("stats: incorrect write & read counters");
+        exit(EXIT_FAILURE);
+    }
+
+    if (after[4] - before[4] != 1 || after[5] == before[5] || after[6] < len) {
+        puts("stats: incorrect empty ring buffer & occupancy counters");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i = 0; i < STATS_COUNT; i++)
+        printf("stats: %-24s +%lld\n", names[i], after[i] - before[i]);
+
+    if (read_attr("statistics/used") != 0) {
+        puts("stats: ring buffer is not empty");
+        exit(EXIT_FAILURE);
+    }
+
+    puts("stats: counters are correct");
+
+    close(fd);
+    return 0;
+}
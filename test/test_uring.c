@@ -0,0 +1,235 @@
+/* linux_driver - Test task: Implementation of Linux driver
+ * Copyright (C) 2024  Alexander (@alkuzin)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>. */
+
+/* TEST IO_URING COMMANDS (enqueue, dequeue & parked commands) */
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <errno.h>
+
+#include "test.h"
+
+#define URING_ENTRIES 4
+
+/** @brief Minimal io_uring instance (liburing is not required). */
+typedef struct {
+    int                  fd;
+    unsigned int        *sq_tail;
+    unsigned int        *sq_mask;
+    unsigned int        *sq_array;
+    unsigned int        *cq_head;
+    unsigned int        *cq_tail;
+    unsigned int        *cq_mask;
+    struct io_uring_cqe *cqes;
+    struct io_uring_sqe *sqes;
+} uring_t;
+
+/**
+ * @brief Set up io_uring instance and map its rings.
+ *
+ * @param [out] ring - given io_uring instance.
+ */
+static void uring_setup(uring_t *ring)
+{
+    struct io_uring_params params;
+    char *sq, *cq;
+
+    memset(&params, 0, sizeof(params));
+    ring->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+
+    if (ring->fd < 0) {
+        perror("io_uring_setup error");
+        exit(EXIT_FAILURE);
+    }
+
+    sq = mmap(NULL, params.sq_off.array + params.sq_entries * sizeof(unsigned int),
+              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    cq = mmap(NULL, params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe),
+              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+
+    if (sq == MAP_FAILED || cq == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        perror("io_uring mmap error");
+        exit(EXIT_FAILURE);
+    }
+
+    ring->sq_tail  = (unsigned int *)(sq + params.sq_off.tail);
+    ring->sq_mask  = (unsigned int *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned int *)(sq + params.sq_off.array);
+    ring->cq_head  = (unsigned int *)(cq + params.cq_off.head);
+    ring->cq_tail  = (unsigned int *)(cq + params.cq_off.tail);
+    ring->cq_mask  = (unsigned int *)(cq + params.cq_off.ring_mask);
+    ring->cqes     = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+}
+
+/**
+ * @brief Submit single driver command.
+ *
+ * @param [in] ring - given io_uring instance.
+ * @param [in] dev - given device file descriptor.
+ * @param [in] op - given driver command (URING_CMD_*).
+ * @param [in] buf - given command buffer.
+ * @param [in] len - given command buffer length.
+ */
+static void uring_submit(uring_t *ring, int dev, unsigned int op, void *buf, unsigned int len)
+{
+    unsigned int        tail = *ring->sq_tail;
+    unsigned int        idx  = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    dev_uring_cmd_t     cmd;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = IORING_OP_URING_CMD;
+    sqe->fd        = dev;
+    sqe->cmd_op    = op;
+    sqe->user_data = op;
+
+    cmd.buf = (unsigned long long)(unsigned long)buf;
+    cmd.len = len;
+    cmd.pad = 0;
+    memcpy(sqe->cmd, &cmd, sizeof(cmd));
+
+    ring->sq_array[idx] = idx;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    if (syscall(__NR_io_uring_enter, ring->fd, 1, 0, 0, NULL, 0) != 1) {
+        perror("io_uring_enter error");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Reap single completion.
+ *
+ * @param [in] ring - given io_uring instance.
+ * @param [in] wait - given flag to wait for completion.
+ * @param [out] cqe - given completion entry.
+ * @return 1 - if completion reaped, 0 - otherwise.
+ */
+static int uring_reap(uring_t *ring, int wait, struct io_uring_cqe *cqe)
+{
+    unsigned int head = *ring->cq_head;
+
+    if (wait && syscall(__NR_io_uring_enter, ring->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+        perror("io_uring_enter error");
+        exit(EXIT_FAILURE);
+    }
+
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+        return 0;
+
+    *cqe = ring->cqes[head & *ring->cq_mask];
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/**
+ * @brief Run command and check its result.
+ *
+ * @param [in] ring - given io_uring instance.
+ * @param [in] dev - given device file descriptor.
+ * @param [in] op - given driver command (URING_CMD_*).
+ * @param [in] buf - given command buffer.
+ * @param [in] len - given command buffer length.
+ * @param [in] expected - given expected command result.
+ */
+static void uring_run(uring_t *ring, int dev, unsigned int op, void *buf, unsigned int len, int expected)
+{
+    struct io_uring_cqe cqe;
+
+    uring_submit(ring, dev, op, buf, len);
+    uring_reap(ring, 1, &cqe);
+
+    if (cqe.user_data != op || cqe.res != expected) {
+        printf("uring: command %#x completed with %d instead of %d\n", op, cqe.res, expected);
+        exit(EXIT_FAILURE);
+    }
+}
+
+int main(void)
+{
+    const char *message = "uring message";
+    int  len = strlen(message);
+    char buffer[BUFFER_SIZE];
+    struct io_uring_cqe cqe;
+    uring_t ring;
+    int fd;
+
+    fd = open(DEVICE_NAME, O_RDWR);
+
+    if (fd == -1) {
+        perror("Error opening " DEVICE_NAME);
+        exit(EXIT_FAILURE);
+    }
+
+    if (ioctl(fd, IOCTL_MSG_MODE, 1) < 0) {
+        perror("set message mode error");
+        exit(EXIT_FAILURE);
+    }
+
+    uring_setup(&ring);
+
+    /* enqueue & dequeue of ready ring buffer complete inline */
+    uring_run(&ring, fd, URING_CMD_WAIT_WRITE, NULL, 0, 0);
+    uring_run(&ring, fd, URING_CMD_ENQUEUE, (void *)message, len, len);
+    uring_run(&ring, fd, URING_CMD_WAIT_READ, NULL, 0, 0);
+
+    memset(buffer, 0, BUFFER_SIZE);
+    uring_run(&ring, fd, URING_CMD_DEQUEUE, buffer, BUFFER_SIZE, len);
+
+    if (memcmp(buffer, message, len) != 0) {
+        printf("uring: incorrect message dequeued: \"%s\"\n", buffer);
+        exit(EXIT_FAILURE);
+    }
+
+    puts("uring: message enqueued & dequeued");
+
+    /* dequeue of empty ring buffer is parked until write() */
+    memset(buffer, 0, BUFFER_SIZE);
+    uring_submit(&ring, fd, URING_CMD_DEQUEUE, buffer, BUFFER_SIZE);
+    usleep(100000);
+
+    if (uring_reap(&ring, 0, &cqe)) {
+        printf("uring: dequeue of empty ring buffer completed with %d\n", cqe.res);
+        exit(EXIT_FAILURE);
+    }
+
+    if (write(fd, message, len) != len) {
+        perror("write error");
+        exit(EXIT_FAILURE);
+    }
+
+    uring_reap(&ring, 1, &cqe);
+
+    if (cqe.res != len || memcmp(buffer, message, len) != 0) {
+        printf("uring: parked dequeue completed with %d\n", cqe.res);
+        exit(EXIT_FAILURE);
+    }
+
+    puts("uring: parked dequeue completed after write");
+
+    /* unknown command */
+    uring_run(&ring, fd, IOCTL_INCORRECT_MODE, NULL, 0, -EINVAL);
+    puts("uring: unknown command rejected");
+
+    close(ring.fd);
+    ioctl(fd, IOCTL_MSG_MODE, 0);
+    close(fd);
+    return 0;
+}
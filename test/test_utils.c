@@ -68,4 +68,27 @@ void display_buf_info(dev_buf_info_t info)
     printf("last write PID:       %d\n", info.last_write_pid);
     printf("last read owner UID:  %d\n", info.last_read_owner);
     printf("last write owner UID: %d\n", info.last_write_owner);
-}
\ No newline at end of file
+}
+
+long long read_attr(const char *name)
+{
+    char path[256];
+    long long value;
+    FILE *file;
+
+    snprintf(path, sizeof(path), SYSFS_DIR "%s", name);
+    file = fopen(path, "r");
+
+    if (!file) {
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+
+    if (fscanf(file, "%lld", &value) != 1) {
+        printf("incorrect attribute: %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    fclose(file);
+    return value;
+}